@@ -0,0 +1,57 @@
+#ifndef JTAGHW_H
+#define JTAGHW_H
+
+#include <stdint.h>
+
+// structure ready for the spi accelerated jtag
+struct S_jtaghw
+{
+  uint8_t *header; // ptr to header nibble (not NULL if exists)
+  uint8_t header_bits; // number of header bits 0-7 (not 0 if exists)
+  uint8_t *data; // ptr to data bytes (not NULL if exists)
+  uint32_t data_bytes; // number of data bytes (not 0 if exists)
+  uint8_t *trailer; // ptr to trailer byte (not NULL if exists)
+  uint8_t trailer_bits; // number of trailer bits 0-7 (not 0 if exists)
+  uint8_t fill; // not 0: data/trailer point to a shared constant page (padding), read only
+  struct S_jtaghw *next; // scatter-gather: segment shifted after this one, NULL if last
+  // last segment only: leaving Shift
+  uint8_t tms_exit; // not 0: last bit is shifted with TMS=1 (Shift -> Exit1)
+  uint8_t tms_post; // TMS bits from Exit1 to the end state, first bit in bit 0
+  uint8_t tms_post_bits; // number of bits in tms_post
+};
+
+// implemented by each jtaghw_*.cpp backend.
+// bit order of data bytes, asked by svf_init() before any
+// scan: 0 - bit 0 shifted first, 1 - bit 7 shifted first.
+// header nibble and trailer bits follow the same order
+uint8_t jtag_msb_first();
+// max bytes of one jtag_tdi_tdo() transfer (DMA limit), 0 if
+// none. longer scans come as several calls, all but the last
+// with tms_exit 0: the TAP stays in Shift between them
+uint32_t jtag_max_transfer();
+// 1 - TDO is read from a target, 0 - tdo chain is made up
+// (no device attached): TDO checks are skipped
+uint8_t jtag_tdo_valid();
+// tdi is a chain of segments shifted without a break,
+// tdo chain has the same layout.
+// TMS stays 0 except as requested by tms_exit/tms_post
+void jtag_tdi_tdo(struct S_jtaghw *tdi, struct S_jtaghw *tdo);
+// expected TDO and MASK of the next scan, packed in shift order,
+// NULL if not checked. for backends checking on their own
+// (XSVF player), others ignore it
+void jtag_expect(uint8_t *tdo, uint8_t *mask, uint32_t bits);
+// clock TMS bits with TDI don't care, first bit is bit 0 of tms[0]
+void jtag_tms(uint8_t *tms, uint32_t bits);
+// RUNTEST: TAP is in the stable state (enum libxsvf_tap_state)
+// and stays there for clocks TCK (TMS 1 in Test-Logic-Reset,
+// else 0), taking at least min_us microseconds in all
+void jtag_runtest(uint8_t state, uint32_t clocks, uint32_t min_us);
+// complete queued transfers: TDO of every scan shifted so
+// far is in its tdo chain when this returns. backends may
+// read TDO back late (USB, network), jtag_tdi_tdo() alone
+// does not guarantee it
+void jtag_flush();
+void jtag_open();
+void jtag_close();
+
+#endif
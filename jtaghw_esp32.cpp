@@ -1,4 +1,5 @@
 #include <stdio.h> // printf
+#include "svfparser.h" // enum libxsvf_tap_state
 #include "jtaghw_esp32.h"
 
 #define DBG_PRINT 0
@@ -8,70 +9,136 @@
 #define PRINTF(f_, ...)
 #endif
 
-extern uint8_t ReverseNibble[]; // instantiated in svfparser.c
+extern const uint8_t ReverseNibble[16]; // instantiated in svfparser.c
 SPIClass *spi_jtag = NULL;
 uint8_t jtag_is_open = 0;
 
-// bitbanging using SPI,
-// store TDO result back to TDI buffer (overwrite)
-// check overwritten TDI buffer with MASK for matching TDO
+// shift bits of data, last bit in bit 0. when exit is set
+// the last bit is clocked alone with TMS=1 (Shift -> Exit1),
+// the rest stays one transfer. return value: TDO bits
+static uint32_t jtag_bits(uint32_t data, uint8_t bits, uint8_t exit)
+{
+  uint32_t out = 0, last;
+  if(exit == 0)
+  {
+    spi_jtag->transferBits(data, &out, bits);
+    return out;
+  }
+  if(bits > 1)
+    spi_jtag->transferBits(data >> 1, &out, bits - 1);
+  last = data & 1;
+  digitalWrite(TMS, 1);
+  spi_jtag->transferBits(last, &last, 1);
+  digitalWrite(TMS, 0);
+  return out << 1 | (last & 1);
+}
+
+// bitbanging using SPI, TDO is stored to the tdo chain.
+// fill segments (padding) are bulk transfers from the shared page
 void jtag_tdi_tdo(struct S_jtaghw *tdi, struct S_jtaghw *tdo)
 {
-  int32_t j;
-  uint32_t data, cmp;
-  int tdo_mismatch = 0;
+  uint32_t data;
+  struct S_jtaghw *last = NULL;
   if(spi_jtag == NULL)
     return;
-  if(tdi->header_bits)
-  {
-    data = tdi->header[0] & 0xF;
-    spi_jtag->transferBits(data, &data, tdi->header_bits); // should be always 4 bits
-    tdo->header[0] = data & 0xF;
-  }
-  if(tdi->data_bytes)
-  {
-    spi_jtag->transferBytes(tdi->data, tdo->data, tdi->data_bytes);
-  }
-  if(tdi->trailer_bits)
-  {
-    data = (tdi->trailer[0]) >> (8 - tdi->trailer_bits);
-    spi_jtag->transferBits(data, &data, tdi->trailer_bits);
-    data <<= (8 - tdi->trailer_bits);
-    tdo->trailer[0] = data;
-  }
-  if(tdi->pad_bits)
+  // scatter-gather: segments are shifted back to back
+  for(; tdi != NULL; tdi = tdi->next, tdo = tdo != NULL ? tdo->next : NULL)
   {
-    // TODO: pad from memory instead of low efficiency loop
-    if((tdi->pad_bits & 7) != 0)
+    // which piece of the last segment has the exit bit
+    uint8_t exit = tdi->next == NULL ? tdi->tms_exit : 0;
+    uint8_t exit_trailer = exit && tdi->trailer_bits;
+    uint8_t exit_data = exit && !exit_trailer && tdi->data_bytes;
+    uint8_t exit_header = exit && !exit_trailer && !exit_data;
+    if(exit)
+      last = tdi;
+    if(tdi->header_bits)
     {
-      data = tdi->pad;
-      spi_jtag->transferBits(data, &data, tdi->pad_bits);
-      /* TODO result of padded data should be written to allocated mem
-      if(tdo)
-      {
-        cmp = tdo->pad;
-        if(data != cmp)
-          tdo_mismatch |= 1;
-      }
-      */
+      data = tdi->header[0] & 0xF;
+      data = jtag_bits(data, tdi->header_bits, exit_header); // should be always 4 bits
+      tdo->header[0] = data & 0xF;
     }
-    /* TODO result of padded data should be written to allocated mem
-    if((tdi->pad_bits / 8) != 0)
+    if(tdi->data_bytes)
     {
-      for(j = 0; j < (tdi->pad_bits / 8); j++)
-      {
-        data = tdi->pad;
-        spi_jtag->transferBits(data, &data, 8);
-        if(tdo)
-        {
-          cmp = tdo->pad;
-          if(data != cmp)
-            tdo_mismatch |= 1;
-        }
-      }
+      // bulk in one transfer, the exit bit from the last byte
+      spi_jtag->transferBytes(tdi->data, tdo->data, tdi->data_bytes - exit_data);
+      if(exit_data)
+        tdo->data[tdi->data_bytes-1] = jtag_bits(tdi->data[tdi->data_bytes-1], 8, 1);
     }
-    */
+    if(tdi->trailer_bits)
+    {
+      data = (tdi->trailer[0]) >> (8 - tdi->trailer_bits);
+      data = jtag_bits(data, tdi->trailer_bits, exit_trailer);
+      data <<= (8 - tdi->trailer_bits);
+      tdo->trailer[0] = data;
+    }
+  }
+  // path from Exit1 to the end state
+  if(last != NULL && last->tms_post_bits)
+    jtag_tms(&last->tms_post, last->tms_post_bits);
+}
+
+// TMS is a GPIO, SPI only supplies the clocks.
+// runs of equal TMS bits are clocked in one transfer
+void jtag_tms(uint8_t *tms, uint32_t bits)
+{
+  uint32_t j, run, data;
+  if(spi_jtag == NULL)
+    return;
+  for(j = 0; j < bits; j += run)
+  {
+    uint8_t level = (tms[j/8] >> (j & 7)) & 1;
+    for(run = 1; j + run < bits && run < 32
+      && ((tms[(j+run)/8] >> ((j+run) & 7)) & 1) == level; run++);
+    digitalWrite(TMS, level);
+    data = 0;
+    spi_jtag->transferBits(data, &data, run);
+  }
+  digitalWrite(TMS, 0);
+}
+
+// clocks with TMS held, then the rest of min_us
+void jtag_runtest(uint8_t state, uint32_t clocks, uint32_t min_us)
+{
+  uint32_t j, run, data;
+  if(spi_jtag == NULL)
+    return;
+  digitalWrite(TMS, state == LIBXSVF_TAP_RESET);
+  for(j = 0; j < clocks; j += run)
+  {
+    run = clocks - j < 32 ? clocks - j : 32;
+    data = 0;
+    spi_jtag->transferBits(data, &data, run);
   }
+  digitalWrite(TMS, 0);
+  uint64_t clocked_us = (uint64_t)clocks * 1000000 / spiClk;
+  if(clocked_us < min_us)
+    delayMicroseconds(min_us - clocked_us);
+}
+
+// SPI shifts bit 7 of each byte first
+uint8_t jtag_msb_first()
+{
+  return 1;
+}
+
+uint32_t jtag_max_transfer()
+{
+  return SPI_MAX_TRANSFER;
+}
+
+uint8_t jtag_tdo_valid()
+{
+  return 1;
+}
+
+// TDO is checked by the host
+void jtag_expect(uint8_t *tdo, uint8_t *mask, uint32_t bits)
+{
+}
+
+// SPI transfers complete before jtag_tdi_tdo() returns
+void jtag_flush()
+{
 }
 
 void jtag_open()
@@ -81,6 +148,8 @@ void jtag_open()
   if(jtag_is_open == 0)
   {
     spi_jtag->begin(TCK, TDO, TDI, 0); // SCLK, MISO, MOSI, SS
+    pinMode(TMS, OUTPUT);
+    digitalWrite(TMS, 0);
     // TODO: remove reversenibble conversion and use LSBFIRST
     spi_jtag->beginTransaction(SPISettings(spiClk, MSBFIRST, SPI_MODE0));
     jtag_is_open = 1;
@@ -1,108 +1,139 @@
 #include <stdio.h> // printf
+#include <stdlib.h> // getenv
+#include <string.h> // memset
 #include "svfparser.h" // reversenibble
 #include "jtaghw_print.h"
 
+#ifndef DBG_PRINT
 #define DBG_PRINT 1
+#endif
 #if DBG_PRINT
 #define PRINTF(f_, ...) printf((f_), ##__VA_ARGS__)
 #else
 #define PRINTF(f_, ...)
 #endif
 
+// JTAG_MSB_FIRST=1 in the environment prints
+// as an MSB-first SPI would shift
+uint8_t jtag_msb_first()
+{
+  const char *env = getenv("JTAG_MSB_FIRST");
+  return env != NULL && env[0] == '1';
+}
+
+// no target, TDO reads zeros
+uint8_t jtag_tdo_valid()
+{
+  return 0;
+}
+
+// JTAG_MAX_TRANSFER=bytes in the environment
+// prints scans in chunks, one line each
+uint32_t jtag_max_transfer()
+{
+  const char *env = getenv("JTAG_MAX_TRANSFER");
+  return env != NULL ? strtoul(env, NULL, 0) : 0;
+}
+
 // bitbanging using SPI
 void jtag_tdi_tdo(struct S_jtaghw *tdi, struct S_jtaghw *tdo)
 {
+  static int8_t msb = -1;
   uint32_t j;
+  if(msb < 0)
+    msb = jtag_msb_first();
   PRINTF("      ");
-  if(tdi->header_bits)
-  {
-    #if REVERSE_NIBBLE
-    PRINTF("0x%01X ", ReverseNibble[tdi->header[0] & 0xF]);
-    #else
-    PRINTF("0x%01X ", tdi->header[0] >> 4);
-    #endif
-    if(tdi->header_bits != 4)
-      PRINTF("<-warning 4 bits expected, found %d. ", tdi->header_bits);
-  }
-  if(tdi->data_bytes)
-  {
-    PRINTF("0x");
-    for(j = 0; j < tdi->data_bytes; j++)
-      #if REVERSE_NIBBLE
-      PRINTF("%01X%01X", ReverseNibble[tdi->data[j] >> 4], ReverseNibble[tdi->data[j] & 0xF]);
-      #else
-      PRINTF("%01X%01X", tdi->data[j] & 0xF, tdi->data[j] >> 4);
-      #endif
-    PRINTF(" ");
-  }
-  if(tdi->trailer_bits)
+  // segments of one scan are printed on one line,
+  // no device: TDO reads all zeros
+  for(; tdi != NULL; tdi = tdi->next, tdo = tdo != NULL ? tdo->next : NULL)
   {
-    uint8_t byte_remaining = tdi->trailer[0];    
-    if(tdi->trailer_bits >= 4)
+    if(tdo != NULL)
     {
-      #if REVERSE_NIBBLE
-      PRINTF("0x%01X ", ReverseNibble[tdi->trailer[0] >> 4]);
-      if(tdi->trailer_bits > 4)
-      {
-        byte_remaining <<= 4;
-        PRINTF("0b");
-        for(j = 4; j < tdi->trailer_bits; j++, byte_remaining <<= 1)
-          PRINTF("%d", byte_remaining >> 7);
-        PRINTF(" ");
-      }
-      #else
-      PRINTF("0x%01X ", tdi->trailer[0] & 0xF);
-      if(tdi->trailer_bits > 4)
-      {
-        byte_remaining >>= 4;
-        PRINTF("0b");
-        for(j = 4; j < tdi->trailer_bits; j++, byte_remaining >>= 1)
-          PRINTF("%d", byte_remaining & 1);
-        PRINTF(" ");
-      }
-      #endif
+      if(tdo->header_bits)
+        tdo->header[0] = 0;
+      if(tdo->data_bytes)
+        memset(tdo->data, 0, tdo->data_bytes);
+      if(tdo->trailer_bits)
+        tdo->trailer[0] = 0;
+    }
+    if(tdi->header_bits)
+    {
+      if(msb)
+        PRINTF("0x%01X ", ReverseNibble[tdi->header[0] & 0xF]);
+      else
+        PRINTF("0x%01X ", tdi->header[0] >> 4);
+      if(tdi->header_bits != 4)
+        PRINTF("<-warning 4 bits expected, found %d. ", tdi->header_bits);
     }
-    else
+    if(tdi->data_bytes)
     {
-      PRINTF("0b");
-      #if REVERSE_NIBBLE
-      for(j = 0; j < tdi->trailer_bits; j++, byte_remaining <<= 1)
-        PRINTF("%d", byte_remaining >> 7);
-      #else
-      for(j = 0; j < tdi->trailer_bits; j++, byte_remaining >>= 1)
-        PRINTF("%d", byte_remaining & 1);
-      #endif
+      PRINTF("0x");
+      for(j = 0; j < tdi->data_bytes; j++)
+        if(msb)
+          PRINTF("%01X%01X", ReverseNibble[tdi->data[j] >> 4], ReverseNibble[tdi->data[j] & 0xF]);
+        else
+          PRINTF("%01X%01X", tdi->data[j] & 0xF, tdi->data[j] >> 4);
       PRINTF(" ");
     }
-  }
-  if(tdi->pad_bits)
-  {
-    if((tdi->pad_bits & 7) != 0)
+    if(tdi->trailer_bits)
     {
-      uint32_t bitcount = tdi->pad_bits & 7;
-      if(bitcount >= 4)
+      // MSB first: reversed to the first bit in bit 0
+      uint8_t byte_remaining = tdi->trailer[0];
+      if(msb)
+        byte_remaining = ReverseNibble[byte_remaining >> 4] | ReverseNibble[byte_remaining & 0xF] << 4;
+      if(tdi->trailer_bits >= 4)
       {
-        PRINTF("0x%01X ", tdi->pad & 0xF);
-        bitcount -= 4;
+        PRINTF("0x%01X ", byte_remaining & 0xF);
+        if(tdi->trailer_bits > 4)
+        {
+          byte_remaining >>= 4;
+          PRINTF("0b");
+          for(j = 4; j < tdi->trailer_bits; j++, byte_remaining >>= 1)
+            PRINTF("%d", byte_remaining & 1);
+          PRINTF(" ");
+        }
       }
-      if(bitcount > 0)
+      else
       {
         PRINTF("0b");
-        for(j = 0; j < bitcount; j++)
-          PRINTF("%d", tdi->pad & 1);
+        for(j = 0; j < tdi->trailer_bits; j++, byte_remaining >>= 1)
+          PRINTF("%d", byte_remaining & 1);
         PRINTF(" ");
       }
     }
-    if((tdi->pad_bits / 8) != 0)
+    if(tdi->tms_exit)
     {
-      PRINTF("0x");
-      for(j = 0; j < (tdi->pad_bits / 8); j++)
-        PRINTF("%02X", tdi->pad);
+      // TMS of the last bit, then the path to the end state
+      PRINTF("TMS 0b1");
+      for(j = 0; j < tdi->tms_post_bits; j++)
+        PRINTF("%d", (tdi->tms_post >> j) & 1);
     }
   }
   PRINTF("\n");
 }
 
+void jtag_tms(uint8_t *tms, uint32_t bits)
+{
+  uint32_t j;
+  PRINTF("      TMS 0b");
+  for(j = 0; j < bits; j++)
+    PRINTF("%d", (tms[j/8] >> (j & 7)) & 1);
+  PRINTF("\n");
+}
+
+void jtag_runtest(uint8_t state, uint32_t clocks, uint32_t min_us)
+{
+  PRINTF("      RUNTEST state %d %u TCK %u us\n", state, clocks, min_us);
+}
+
+void jtag_expect(uint8_t *tdo, uint8_t *mask, uint32_t bits)
+{
+}
+
+void jtag_flush()
+{
+}
+
 void jtag_open()
 {
   PRINTF("jtag open\n");
@@ -0,0 +1,376 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "svfparser.h" // enum libxsvf_tap_state
+#include "svftap.h"
+#include "svfscan.h"
+#include "jtaghw_sim.h"
+
+#ifndef DBG_PRINT
+#define DBG_PRINT 1
+#endif
+#if DBG_PRINT
+#define PRINTF(f_, ...) printf((f_), ##__VA_ARGS__)
+#else
+#define PRINTF(f_, ...)
+#endif
+
+/*
+simulated target: no hardware, a chain of TAP controllers
+answers the scans, for benchmarks and tests on the host.
+
+TMS bits walk the TAP state machine. entering Capture loads
+the register each device has selected into one chain shift
+register, Shift moves TDI in and TDO out of it, entering
+Update latches the instruction (IR) or the config register
+(DR). Test-Logic-Reset selects IDCODE, or BYPASS if none.
+
+registers per device: IR (captures ...01), IDCODE (32 bits),
+config register (reads back what was written), BYPASS for
+all other instructions (one bit, captures 0).
+
+chain register is packed bit 0 first (next bit at TDO),
+converted from and to the backend bit order per scan.
+*/
+
+struct S_simdev
+{
+  uint8_t ir_len;
+  uint32_t idcode; // 0: no IDCODE register
+  uint32_t idcode_op, cfg_op;
+  uint32_t cfg_bits; // 0: no config register
+  uint8_t *cfg; // config register contents
+  uint32_t ir; // current instruction
+  uint32_t at, bits; // register in the chain since Capture
+  uint8_t cfg_sel; // 1: it is the config register, of any length
+};
+
+struct S_sim
+{
+  uint8_t msb; // bit order of the scans
+  uint8_t open;
+  uint8_t state;
+  uint8_t ir; // chain register holds IR (1) or DR (0)
+  uint8_t devices;
+  struct S_simdev dev[SIM_DEVICES_MAX];
+  uint8_t *reg; // chain register
+  uint32_t reg_bits;
+  uint8_t *buf; // TDI, then chain register followed by TDI
+  uint32_t allocated;
+  uint64_t tck; // clocks
+  uint64_t shifted; // bits shifted in jtag_tdi_tdo()
+  uint32_t transfers; // jtag_tdi_tdo() calls
+};
+
+static struct S_sim Sim;
+
+// buffers for a shift of bits through the chain register
+// return value:
+// 0 - ok
+// -1 - memory allocation failed
+static int8_t sim_reserve(uint32_t bits)
+{
+  // TDI, chain register + TDI, new chain register
+  uint32_t need = 2*((bits+7)/8) + 2*((Sim.reg_bits+7)/8) + 2;
+  if(need > Sim.allocated)
+  {
+    uint8_t *buf = (uint8_t *)realloc(Sim.buf, need);
+    if(buf == NULL)
+      return -1;
+    Sim.buf = buf;
+    Sim.allocated = need;
+  }
+  return 0;
+}
+
+// clear bits from n on in the last byte of n bits
+static void sim_clear_above(uint8_t *p, uint32_t n)
+{
+  if(n & 7)
+    p[n/8] &= 0xFF >> (8 - (n & 7));
+}
+
+// shift n bits of tdi (packed bit 0 first, bits above n 0)
+// through the chain register. return value: TDO, n bits
+// in Sim.buf, valid until the next shift
+static uint8_t *sim_shift(const uint8_t *tdi, uint32_t n)
+{
+  uint32_t reg_bytes = (Sim.reg_bits+7)/8;
+  uint8_t *all = Sim.buf + (n+7)/8; // chain register, then TDI
+  uint8_t *reg = all + reg_bytes + (n+7)/8 + 1;
+  memcpy(all, Sim.reg, reg_bytes);
+  memset(all + reg_bytes, 0, (n+7)/8 + 1);
+  svfscan_bits_merge(all, Sim.reg_bits, tdi, n, 0);
+  // last reg_bits bits stay in the chain, first n come out
+  svfscan_bits_extract(reg, all, n, Sim.reg_bits, 0);
+  sim_clear_above(reg, Sim.reg_bits);
+  memcpy(Sim.reg, reg, reg_bytes);
+  Sim.shifted += n;
+  return all;
+}
+
+// Capture: registers selected by each device into the chain
+static void sim_capture(uint8_t ir)
+{
+  uint32_t at = 0, j;
+  uint8_t v[4];
+  for(j = 0; j < Sim.devices; j++)
+  {
+    struct S_simdev *d = &Sim.dev[j];
+    d->at = at;
+    d->cfg_sel = 0;
+    if(ir)
+      d->bits = d->ir_len;
+    else if(d->idcode != 0 && d->ir == d->idcode_op)
+      d->bits = 32;
+    else if(d->cfg_bits != 0 && d->ir == d->cfg_op)
+    {
+      d->bits = d->cfg_bits;
+      d->cfg_sel = 1;
+    }
+    else
+      d->bits = 1; // BYPASS
+    at += d->bits;
+  }
+  uint8_t *reg = (uint8_t *)realloc(Sim.reg, (at+7)/8 + 1);
+  if(reg == NULL)
+  {
+    PRINTF("Memory Allocation Failed\n");
+    Sim.reg_bits = 0;
+    return;
+  }
+  Sim.reg = reg;
+  Sim.reg_bits = at;
+  Sim.ir = ir;
+  memset(Sim.reg, 0, (at+7)/8 + 1);
+  for(j = 0; j < Sim.devices; j++)
+  {
+    struct S_simdev *d = &Sim.dev[j];
+    if(ir)
+    {
+      v[0] = 1; // IR captures ...01
+      svfscan_bits_merge(Sim.reg, d->at, v, 2, 0);
+    }
+    else if(d->cfg_sel)
+      svfscan_bits_merge(Sim.reg, d->at, d->cfg, d->cfg_bits, 0);
+    else if(d->bits == 32)
+    {
+      for(int k = 0; k < 4; k++)
+        v[k] = d->idcode >> (8*k);
+      svfscan_bits_merge(Sim.reg, d->at, v, 32, 0);
+    }
+  }
+}
+
+// Update: instruction or config register from the chain
+static void sim_update()
+{
+  uint8_t v[4];
+  for(uint32_t j = 0; j < Sim.devices; j++)
+  {
+    struct S_simdev *d = &Sim.dev[j];
+    if(Sim.ir)
+    {
+      memset(v, 0, sizeof(v));
+      svfscan_bits_extract(v, Sim.reg, d->at, d->ir_len, 0);
+      d->ir = (v[0] | v[1] << 8 | v[2] << 16 | (uint32_t)v[3] << 24) & (0xFFFFFFFF >> (32 - d->ir_len));
+    }
+    else if(d->cfg_sel)
+    {
+      svfscan_bits_extract(d->cfg, Sim.reg, d->at, d->cfg_bits, 0);
+      sim_clear_above(d->cfg, d->cfg_bits);
+    }
+  }
+}
+
+// Test-Logic-Reset: IDCODE, or BYPASS if none
+static void sim_reset()
+{
+  for(uint32_t j = 0; j < Sim.devices; j++)
+  {
+    struct S_simdev *d = &Sim.dev[j];
+    d->ir = d->idcode != 0 ? d->idcode_op : 0xFFFFFFFF >> (32 - d->ir_len);
+  }
+}
+
+// one TCK: Shift states shift a 0 (TDI don't care)
+static void sim_clock(uint8_t tms)
+{
+  uint8_t zero = 0;
+  if(Sim.state == LIBXSVF_TAP_DRSHIFT || Sim.state == LIBXSVF_TAP_IRSHIFT)
+    if(sim_reserve(1) == 0)
+      sim_shift(&zero, 1);
+  Sim.state = svftap_next(Sim.state, tms);
+  Sim.tck++;
+  if(Sim.state == LIBXSVF_TAP_RESET)
+    sim_reset();
+  else if(Sim.state == LIBXSVF_TAP_DRCAPTURE || Sim.state == LIBXSVF_TAP_IRCAPTURE)
+    sim_capture(Sim.state == LIBXSVF_TAP_IRCAPTURE);
+  else if(Sim.state == LIBXSVF_TAP_DRUPDATE || Sim.state == LIBXSVF_TAP_IRUPDATE)
+    sim_update();
+}
+
+// JTAG_MSB_FIRST=1 in the environment
+// simulates an MSB-first SPI
+uint8_t jtag_msb_first()
+{
+  const char *env = getenv("JTAG_MSB_FIRST");
+  return env != NULL && env[0] == '1';
+}
+
+// simulated chain answers the scans
+uint8_t jtag_tdo_valid()
+{
+  return 1;
+}
+
+// JTAG_MAX_TRANSFER=bytes in the environment
+// splits scans as a DMA limit would
+uint32_t jtag_max_transfer()
+{
+  const char *env = getenv("JTAG_MAX_TRANSFER");
+  return env != NULL ? strtoul(env, NULL, 0) : 0;
+}
+
+// TDO is checked by the host
+void jtag_expect(uint8_t *tdo, uint8_t *mask, uint32_t bits)
+{
+}
+
+void jtag_tdi_tdo(struct S_jtaghw *tdi, struct S_jtaghw *tdo)
+{
+  struct S_jtaghw *hw, *last = tdi;
+  uint32_t bits = 0;
+  if(!Sim.open)
+    return;
+  if(Sim.state != LIBXSVF_TAP_DRSHIFT && Sim.state != LIBXSVF_TAP_IRSHIFT)
+  {
+    PRINTF("sim: scan not in a Shift state\n");
+    return;
+  }
+  for(hw = tdi; hw != NULL; last = hw, hw = hw->next)
+    bits += hw->header_bits + 8 * hw->data_bytes + hw->trailer_bits;
+  if(sim_reserve(bits) < 0)
+  {
+    PRINTF("Memory Allocation Failed\n");
+    return;
+  }
+  memset(Sim.buf, 0, (bits+7)/8);
+  svfscan_gather(tdi, Sim.buf, Sim.msb);
+  if(Sim.msb)
+    svfscan_reverse(Sim.buf, (bits+7)/8);
+  uint8_t *out = sim_shift(Sim.buf, bits);
+  if(Sim.msb)
+    svfscan_reverse(out, (bits+7)/8);
+  if(tdo != NULL)
+    svfscan_scatter(tdo, out, Sim.msb);
+  Sim.tck += bits;
+  Sim.transfers++;
+  if(last->tms_exit)
+  {
+    // last bit was shifted with TMS=1
+    Sim.state = svftap_next(Sim.state, 1);
+    for(uint8_t j = 0; j < last->tms_post_bits; j++)
+      sim_clock((last->tms_post >> j) & 1);
+  }
+}
+
+void jtag_tms(uint8_t *tms, uint32_t bits)
+{
+  if(!Sim.open)
+    return;
+  for(uint32_t j = 0; j < bits; j++)
+    sim_clock((tms[j/8] >> (j & 7)) & 1);
+}
+
+// stable state: clocks change nothing, time is not simulated
+void jtag_runtest(uint8_t state, uint32_t clocks, uint32_t min_us)
+{
+  if(!Sim.open)
+    return;
+  if(Sim.state != state)
+    PRINTF("sim: RUNTEST not in its state\n");
+  Sim.tck += clocks;
+}
+
+// scans complete before jtag_tdi_tdo() returns
+void jtag_flush()
+{
+}
+
+// chain from JTAG_SIM_CHAIN or the default device
+// return value:
+// 0 - ok
+// -1 - bad chain description
+static int8_t sim_chain(const char *s)
+{
+  Sim.devices = 0;
+  while(Sim.devices < SIM_DEVICES_MAX)
+  {
+    struct S_simdev *d = &Sim.dev[Sim.devices++];
+    uint32_t field[5] = { SIM_IR_LEN, SIM_IDCODE, SIM_IDCODE_OP, SIM_CFG_OP, SIM_CFG_BITS };
+    char *end;
+    for(int j = 0; j < 5 && s != NULL && *s != '\0' && *s != ','; j++)
+    {
+      if(*s != ':')
+      {
+        field[j] = strtoul(s, &end, 0);
+        if(end == s)
+          return -1;
+        s = end;
+      }
+      if(*s == ':')
+        s++;
+    }
+    if(field[0] < 2 || field[0] > 32)
+      return -1;
+    d->ir_len = field[0];
+    d->idcode = field[1];
+    d->idcode_op = field[2];
+    d->cfg_op = field[3];
+    d->cfg_bits = field[4];
+    if(s == NULL || *s != ',')
+      return 0;
+    s++;
+  }
+  return -1;
+}
+
+void jtag_open()
+{
+  memset(&Sim, 0, sizeof(Sim));
+  if(sim_chain(getenv("JTAG_SIM_CHAIN")) < 0)
+  {
+    PRINTF("sim: bad JTAG_SIM_CHAIN\n");
+    return;
+  }
+  for(uint32_t j = 0; j < Sim.devices; j++)
+  {
+    struct S_simdev *d = &Sim.dev[j];
+    if(d->cfg_bits == 0)
+      continue;
+    d->cfg = (uint8_t *)calloc((d->cfg_bits+7)/8, 1);
+    if(d->cfg == NULL)
+    {
+      PRINTF("Memory Allocation Failed\n");
+      d->cfg_bits = 0;
+    }
+  }
+  Sim.msb = jtag_msb_first();
+  Sim.state = LIBXSVF_TAP_RESET;
+  sim_reset();
+  Sim.open = 1;
+  PRINTF("sim open, %d devices\n", Sim.devices);
+}
+
+void jtag_close()
+{
+  if(Sim.open)
+    PRINTF("sim close, %llu TCK, %u transfers, %llu bits shifted\n",
+      (unsigned long long)Sim.tck, Sim.transfers, (unsigned long long)Sim.shifted);
+  for(uint32_t j = 0; j < Sim.devices; j++)
+    free(Sim.dev[j].cfg);
+  free(Sim.reg);
+  free(Sim.buf);
+  memset(&Sim, 0, sizeof(Sim));
+}
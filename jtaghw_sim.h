@@ -0,0 +1,22 @@
+#ifndef JTAGHW_SIM_H
+#define JTAGHW_SIM_H
+
+#include "jtaghw.h"
+
+// max devices in the simulated chain
+#define SIM_DEVICES_MAX 8
+
+// default chain: one FPGA like the one bitstream.svf is for.
+// JTAG_SIM_CHAIN in the environment overrides it, devices
+// separated by ',' starting from the one next to TDO (gets
+// the bits shifted first, HIR/HDR), fields separated by ':'
+//   ir_len:idcode:idcode_op:cfg_op:cfg_bits
+// missing fields take the defaults below, idcode 0: device
+// without IDCODE register, cfg_bits 0: no config register
+#define SIM_IR_LEN 8
+#define SIM_IDCODE 0x41112043
+#define SIM_IDCODE_OP 0xE0
+#define SIM_CFG_OP 0x7A
+#define SIM_CFG_BITS 65536
+
+#endif
@@ -0,0 +1,370 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "svfparser.h" // enum libxsvf_tap_state
+#include "svftap.h"
+#include "svfscan.h"
+#include "jtaghw_xsvf.h"
+
+#ifndef DBG_PRINT
+#define DBG_PRINT 1
+#endif
+#if DBG_PRINT
+#define PRINTF(f_, ...) printf((f_), ##__VA_ARGS__)
+#else
+#define PRINTF(f_, ...)
+#endif
+
+/*
+XSVF writer: no hardware, scans and TMS moves are
+written to a file for an XSVF player.
+
+TMS bits are followed through the TAP state machine.
+the player walks its own shortest paths (XSTATE), a state
+is written only where the walk leaves that path, clocks
+looping in a stable state become XWAIT. scans become
+XSIR/XSIR2 or XSDR/XSDRTDO, the end state of each scan
+is found from its exit TMS bits.
+sticky values (XSDRSIZE, XTDOMASK, XENDIR, XENDDR)
+are written only when they change.
+
+clocks are written as microseconds: equal at 1 MHz TCK,
+RUNTEST waits the longer of its clocks and its min time.
+*/
+
+// XSVF TAP state code: libxsvf state counted from RESET
+#define XSVF_STATE(s) ((s) - LIBXSVF_TAP_RESET)
+
+struct S_xsvf
+{
+  FILE *fp;
+  uint8_t state; // TAP state followed from the TMS bits
+  uint8_t xstate; // state the player is in
+  uint8_t walk_tms, walk_bits; // TMS bits from xstate to state
+  uint32_t wait; // clocks looping in state, not yet written
+  uint8_t endir, enddr; // sticky XENDIR, XENDDR, 0xFF if not written
+  uint32_t sdrsize; // sticky XSDRSIZE, 0 if not written
+  uint8_t *mask; // sticky XTDOMASK of sdrsize bits, XSVF order
+  uint8_t mask_valid;
+  uint32_t mask_allocated;
+  uint8_t *tdo, *tdo_mask; // expected TDO of the next scan, NULL if none
+  uint32_t tdo_bits;
+  uint8_t sir_tdo_noted; // SIR TDO dropped message printed
+  uint8_t *buf; // gathered bits and vectors of a scan
+  uint32_t allocated;
+};
+
+static struct S_xsvf Xsvf;
+
+static void put8(uint8_t v)
+{
+  fputc(v, Xsvf.fp);
+}
+
+static void put32(uint32_t v)
+{
+  put8(v >> 24);
+  put8(v >> 16);
+  put8(v >> 8);
+  put8(v);
+}
+
+// bits packed in shift order to XSVF vector: byte order reversed
+static void vector(uint8_t *dst, const uint8_t *src, uint32_t bits)
+{
+  uint32_t bytes = (bits+7)/8;
+  for(uint32_t j = 0; j < bytes; j++)
+    dst[bytes-1-j] = src[j];
+}
+
+static uint8_t stable(uint8_t state)
+{
+  return state == LIBXSVF_TAP_RESET || state == LIBXSVF_TAP_IDLE
+    || state == LIBXSVF_TAP_DRPAUSE || state == LIBXSVF_TAP_IRPAUSE;
+}
+
+// player walks to state
+static void xsvf_goto(uint8_t state)
+{
+  Xsvf.walk_tms = 0;
+  Xsvf.walk_bits = 0;
+  if(state == Xsvf.xstate)
+    return;
+  put8(XSTATE);
+  put8(XSVF_STATE(state));
+  Xsvf.xstate = state;
+}
+
+// clocks counted in the current stable state
+static void xsvf_wait()
+{
+  if(Xsvf.wait == 0)
+    return;
+  if(Xsvf.state != LIBXSVF_TAP_RESET)
+  {
+    put8(XWAIT);
+    put8(XSVF_STATE(Xsvf.state));
+    put8(XSVF_STATE(Xsvf.state));
+    put32(Xsvf.wait);
+  }
+  Xsvf.wait = 0;
+}
+
+// one TCK with tms
+static void xsvf_clock(uint8_t tms)
+{
+  uint8_t next = svftap_next(Xsvf.state, tms);
+  uint8_t path_tms, path_bits;
+  if(next == Xsvf.state && stable(next))
+  {
+    xsvf_goto(next); // player stops here
+    Xsvf.wait++;
+    return;
+  }
+  xsvf_wait();
+  // walk goes on along the player's path or the player
+  // is sent to the state before, one TMS bit from next
+  if(Xsvf.walk_bits < 8)
+  {
+    Xsvf.walk_tms |= tms << Xsvf.walk_bits;
+    Xsvf.walk_bits++;
+    path_bits = svftap_tms(Xsvf.xstate, next, &path_tms);
+    if(path_bits == Xsvf.walk_bits && path_tms == Xsvf.walk_tms)
+    {
+      Xsvf.state = next;
+      return;
+    }
+  }
+  xsvf_goto(Xsvf.state);
+  Xsvf.walk_tms = tms;
+  Xsvf.walk_bits = 1;
+  Xsvf.state = next;
+}
+
+uint8_t jtag_msb_first()
+{
+  return 0;
+}
+
+// the XSVF player compares TDO, not the writer
+uint8_t jtag_tdo_valid()
+{
+  return 0;
+}
+
+// XSIR/XSDR take a whole scan
+uint32_t jtag_max_transfer()
+{
+  return 0;
+}
+
+void jtag_expect(uint8_t *tdo, uint8_t *mask, uint32_t bits)
+{
+  Xsvf.tdo = tdo;
+  Xsvf.tdo_mask = mask;
+  Xsvf.tdo_bits = bits;
+}
+
+void jtag_tdi_tdo(struct S_jtaghw *tdi, struct S_jtaghw *tdo)
+{
+  struct S_jtaghw *hw, *last = tdi;
+  uint32_t bits = 0, bytes;
+  uint8_t ir = Xsvf.state == LIBXSVF_TAP_IRSHIFT;
+  uint8_t end, xend;
+  if(Xsvf.fp == NULL)
+    return;
+  if(!ir && Xsvf.state != LIBXSVF_TAP_DRSHIFT)
+  {
+    PRINTF("xsvf: scan not in a Shift state\n");
+    return;
+  }
+  for(hw = tdi; hw != NULL; last = hw, hw = hw->next)
+    bits += hw->header_bits + 8 * hw->data_bytes + hw->trailer_bits;
+  // no device: TDO reads all zeros
+  for(hw = tdo; hw != NULL; hw = hw->next)
+  {
+    if(hw->header_bits)
+      hw->header[0] = 0;
+    if(hw->data_bytes)
+      memset(hw->data, 0, hw->data_bytes);
+    if(hw->trailer_bits)
+      hw->trailer[0] = 0;
+  }
+  if(bits == 0)
+    return;
+  // gathered bits, then TDI, TDO and MASK vectors
+  bytes = (bits+7)/8;
+  if(4*bytes > Xsvf.allocated)
+  {
+    uint8_t *buf = (uint8_t *)realloc(Xsvf.buf, 4*bytes);
+    if(buf == NULL)
+    {
+      PRINTF("Memory Allocation Failed\n");
+      return;
+    }
+    Xsvf.buf = buf;
+    Xsvf.allocated = 4*bytes;
+  }
+  uint8_t *vtdi = Xsvf.buf + bytes, *vtdo = Xsvf.buf + 2*bytes, *vmask = Xsvf.buf + 3*bytes;
+  // end state from the exit bit and the path after Exit1
+  end = Xsvf.state;
+  if(last->tms_exit)
+  {
+    end = svftap_next(end, 1);
+    for(uint8_t j = 0; j < last->tms_post_bits; j++)
+      end = svftap_next(end, (last->tms_post >> j) & 1);
+  }
+  xend = end == (ir ? LIBXSVF_TAP_IRPAUSE : LIBXSVF_TAP_DRPAUSE);
+  memset(Xsvf.buf, 0, bytes);
+  svfscan_gather(tdi, Xsvf.buf, 0);
+  vector(vtdi, Xsvf.buf, bits);
+  if(ir && bits > 0xFFFF)
+    PRINTF("xsvf: SIR of %u bits does not fit in XSIR2, not written\n", bits);
+  else if(ir)
+  {
+    // XSIR has no TDO compare
+    if(Xsvf.tdo != NULL && !Xsvf.sir_tdo_noted)
+    {
+      PRINTF("xsvf: XSIR can not check TDO, TDO/MASK of SIR not written\n");
+      Xsvf.sir_tdo_noted = 1;
+    }
+    if(Xsvf.endir != xend)
+    {
+      put8(XENDIR);
+      put8(xend);
+      Xsvf.endir = xend;
+    }
+    if(bits < 256)
+    {
+      put8(XSIR);
+      put8(bits);
+    }
+    else
+    {
+      put8(XSIR2);
+      put8(bits >> 8);
+      put8(bits);
+    }
+    fwrite(vtdi, 1, bytes, Xsvf.fp);
+  }
+  else
+  {
+    uint8_t check = Xsvf.tdo != NULL && Xsvf.tdo_bits == bits;
+    if(Xsvf.enddr != xend)
+    {
+      put8(XENDDR);
+      put8(xend);
+      Xsvf.enddr = xend;
+    }
+    if(Xsvf.sdrsize != bits)
+    {
+      put8(XSDRSIZE);
+      put32(bits);
+      Xsvf.sdrsize = bits;
+      Xsvf.mask_valid = 0;
+    }
+    // not checked: mask of zeros
+    if(check)
+      vector(vmask, Xsvf.tdo_mask, bits);
+    else
+      memset(vmask, 0, bytes);
+    if(!Xsvf.mask_valid || memcmp(Xsvf.mask, vmask, bytes) != 0)
+    {
+      if(bytes > Xsvf.mask_allocated)
+      {
+        uint8_t *mask = (uint8_t *)realloc(Xsvf.mask, bytes);
+        if(mask == NULL)
+        {
+          PRINTF("Memory Allocation Failed\n");
+          return;
+        }
+        Xsvf.mask = mask;
+        Xsvf.mask_allocated = bytes;
+      }
+      memcpy(Xsvf.mask, vmask, bytes);
+      Xsvf.mask_valid = 1;
+      put8(XTDOMASK);
+      fwrite(vmask, 1, bytes, Xsvf.fp);
+    }
+    if(check)
+    {
+      vector(vtdo, Xsvf.tdo, bits);
+      put8(XSDRTDO);
+      fwrite(vtdi, 1, bytes, Xsvf.fp);
+      fwrite(vtdo, 1, bytes, Xsvf.fp);
+    }
+    else
+    {
+      put8(XSDR);
+      fwrite(vtdi, 1, bytes, Xsvf.fp);
+    }
+  }
+  Xsvf.tdo = NULL;
+  // player is in the XENDIR/XENDDR state, walks on if needed
+  Xsvf.xstate = xend ? end : LIBXSVF_TAP_IDLE;
+  Xsvf.state = end;
+  xsvf_goto(end);
+}
+
+void jtag_tms(uint8_t *tms, uint32_t bits)
+{
+  if(Xsvf.fp == NULL)
+    return;
+  for(uint32_t j = 0; j < bits; j++)
+    xsvf_clock((tms[j/8] >> (j & 7)) & 1);
+}
+
+void jtag_runtest(uint8_t state, uint32_t clocks, uint32_t min_us)
+{
+  if(Xsvf.fp == NULL || state != Xsvf.state)
+    return;
+  xsvf_goto(state); // player stops here
+  Xsvf.wait += clocks > min_us ? clocks : min_us;
+}
+
+void jtag_flush()
+{
+  if(Xsvf.fp != NULL)
+    fflush(Xsvf.fp);
+}
+
+void jtag_open()
+{
+  const char *name = getenv("XSVF_FILE");
+  if(name == NULL)
+    name = XSVF_FILE;
+  memset(&Xsvf, 0, sizeof(Xsvf));
+  Xsvf.fp = fopen(name, "wb");
+  if(Xsvf.fp == NULL)
+  {
+    PRINTF("can't create %s\n", name);
+    return;
+  }
+  Xsvf.endir = 0xFF;
+  Xsvf.enddr = 0xFF;
+  // SVF has no retries and no implicit run time
+  put8(XREPEAT);
+  put8(0);
+  put8(XRUNTEST);
+  put32(0);
+  put8(XSTATE);
+  put8(XSVF_STATE(LIBXSVF_TAP_RESET));
+  Xsvf.state = LIBXSVF_TAP_RESET;
+  Xsvf.xstate = LIBXSVF_TAP_RESET;
+  PRINTF("xsvf open %s\n", name);
+}
+
+void jtag_close()
+{
+  if(Xsvf.fp != NULL)
+  {
+    xsvf_wait();
+    xsvf_goto(Xsvf.state);
+    put8(XCOMPLETE);
+    fclose(Xsvf.fp);
+    PRINTF("xsvf close\n");
+  }
+  free(Xsvf.buf);
+  free(Xsvf.mask);
+  memset(&Xsvf, 0, sizeof(Xsvf));
+}
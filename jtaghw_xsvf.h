@@ -0,0 +1,29 @@
+#ifndef JTAGHW_XSVF_H
+#define JTAGHW_XSVF_H
+
+#include "jtaghw.h"
+
+// output file, XSVF_FILE in the environment overrides it
+#define XSVF_FILE "svf.xsvf"
+
+// XSVF instructions, each followed by its arguments,
+// numbers are big endian, bit vectors too: last bit
+// of the last byte is shifted first
+enum xsvf_instruction
+{
+  XCOMPLETE = 0x00, // end of stream
+  XTDOMASK = 0x01, // mask[XSDRSIZE]: sticky mask for XSDR/XSDRTDO
+  XSIR = 0x02, // bits(1) tdi[bits]
+  XSDR = 0x03, // tdi[XSDRSIZE], TDO compared with the last expected
+  XRUNTEST = 0x04, // usecs(4) in Run-Test/Idle after each XSIR/XSDR
+  XREPEAT = 0x07, // times(1) to retry a failing XSDR
+  XSDRSIZE = 0x08, // bits(4): sticky length of XSDR vectors
+  XSDRTDO = 0x09, // tdi[XSDRSIZE] tdo[XSDRSIZE]: shift and compare
+  XSTATE = 0x12, // state(1): walk to TAP state
+  XENDIR = 0x13, // 0 - Run-Test/Idle, 1 - Pause-IR after XSIR
+  XENDDR = 0x14, // 0 - Run-Test/Idle, 1 - Pause-DR after XSDR
+  XSIR2 = 0x15, // bits(2) tdi[bits]
+  XWAIT = 0x17, // wait_state(1) end_state(1) usecs(4)
+};
+
+#endif
@@ -1,38 +1,129 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include "svfparser.h"
+#include "svfbin.h"
+#include "svfinput.h"
+#include "svfpipe.h"
+#include "svfstats.h"
+#include "svftrace.h"
 
-// get chunk by chunk (simulate network) and call the parser
-int packetize(char *filename, size_t size)
+// compile svf file to binary op stream
+int compile(struct S_svfparser *ctx, char *filename, char *outname)
 {
-  FILE *fp = fopen(filename, "rb");
-  if(fp == NULL)
+  FILE *out = fopen(outname, "wb");
+  if(out == NULL)
   {
-    printf("can't open %s\n", filename);
+    printf("can't create %s\n", outname);
     return -1;
   }
-  uint8_t *packet_data = (uint8_t *) malloc(size * sizeof(uint8_t));
-  size_t packet_len;
-  size_t index = 0;
+  struct S_svf_sink sink;
+  svfbin_compile_open(ctx, &sink, out);
+  int result = svf_read_packets(ctx, filename, SVF_PACKET_SIZE);
+  svfbin_compile_close(ctx);
+  fclose(out);
+  return result;
+}
+
+// parse and shift in parallel
+int pipelined(struct S_svfparser *ctx, char *filename)
+{
+  struct S_svfpipe pipe;
+  if(svfpipe_start(&pipe, &ctx->verify, &ctx->stats.shift, &ctx->stats.reallocs) < 0)
+    return -1;
+  ctx->pipe = &pipe;
+  int result = svf_read_packets(ctx, filename, SVF_PACKET_SIZE);
+  svfpipe_stop(&pipe);
+  ctx->pipe = NULL;
+  return result;
+}
 
-  while(!feof(fp))
+// counters as JSON to the file named by SVF_STATS,
+// to stderr if not set
+void stats(struct S_svfparser *ctx)
+{
+  const char *name = getenv("SVF_STATS");
+  FILE *fp = name != NULL ? fopen(name, "w") : stderr;
+  if(fp == NULL)
   {
-    packet_len = fread(packet_data, 1, size, fp);
-    int final = packet_len < size ? 1 : 0;
-    parse_svf_packet(packet_data, index, packet_len, final);
-    index += packet_len;
-    printf("packet len %ld\n", packet_len);
+    printf("can't create %s\n", name);
+    return;
   }
-  printf("total len %ld\n", index);
-  free(packet_data);
-  return 0;
+  svfstats_json(ctx, fp);
+  if(fp != stderr)
+    fclose(fp);
 }
 
+#if SVF_TRACE
+// last parser events of a failed run to the file named
+// by SVF_TRACE, nothing written if not set. svftracedec prints it
+void trace(struct S_svfparser *ctx)
+{
+  const char *name = getenv("SVF_TRACE");
+  if(name == NULL)
+    return;
+  if(svftrace_write(&ctx->trace, name) < 0)
+    printf("can't create %s\n", name);
+  else
+    printf("trace of %u events written to %s\n", ctx->trace.head, name);
+}
+#endif
+
+// load compiled op stream and play it
+int replay(char *filename)
+{
+  FILE *fp = fopen(filename, "rb");
+  if(fp == NULL)
+  {
+    printf("can't open %s\n", filename);
+    return -1;
+  }
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  uint8_t *stream = (uint8_t *) malloc(size > 0 ? size : 1);
+  size_t stream_len = fread(stream, 1, size, fp);
+  fclose(fp);
+  int result = svfbin_replay(stream, stream_len);
+  free(stream);
+  return result;
+}
 
 int main(int argc, char *argv[])
 {
+  struct S_svfparser svf;
+  int result = 0;
   puts("svf parser");
-  if(argc > 1)
-    packetize(argv[1], 1436);
+  if(argc > 2 && strcmp(argv[1], "-r") == 0)
+    return replay(argv[2]) < 0 ? 1 : 0;
+  svf_init(&svf);
+  // -d before other options: TDO checks are deferred and batched
+  if(argc > 2 && strcmp(argv[1], "-d") == 0)
+  {
+    svf.verify.deferred = 1;
+    argv++;
+    argc--;
+  }
+  if(argc > 3 && strcmp(argv[1], "-c") == 0)
+    result = compile(&svf, argv[2], argv[3]);
+  else if(argc > 2 && strcmp(argv[1], "-m") == 0)
+    result = svf_read_mmap(&svf, argv[2]);
+  else if(argc > 2 && strcmp(argv[1], "-p") == 0)
+    result = pipelined(&svf, argv[2]);
+  else if(argc > 1)
+    result = svf_read_packets(&svf, argv[1], SVF_PACKET_SIZE);
+  // checks still queued when the stream stopped early
+  svfverify_run(&svf.verify);
+  // counters only of a stream that was read, not
+  // without a file or when it can't be opened
+  if(svf.stats.bytes > 0 || (argc > 1 && result >= 0))
+    stats(&svf);
+  #if SVF_TRACE
+  if(result < 0 || svf.verify.failures > 0 || svf.cmderr < 0)
+    trace(&svf);
+  #endif
+  uint32_t failures = svf.verify.failures;
+  svf_free(&svf);
+  return result < 0 || failures > 0 ? 1 : 0;
 }
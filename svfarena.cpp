@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <string.h>
+#include "svfarena.h"
+#if defined(ESP32)
+#include "esp_heap_caps.h"
+#endif
+
+// slab header, padded to keep the chunks aligned
+#define SLAB_HEADER SVF_ARENA_ALIGN
+
+// slab of up to SVF_ARENA_SLAB_CHUNKS, fewer if memory is
+// short (fragmented DMA heap), *chunks gets the count
+static uint8_t *slab_alloc(uint32_t *chunks)
+{
+  uint8_t *slab = NULL;
+  for(*chunks = SVF_ARENA_SLAB_CHUNKS; *chunks > 0; *chunks /= 2)
+  {
+    size_t bytes = SLAB_HEADER + (size_t)*chunks * SVF_ARENA_CHUNK_BYTES;
+    #if defined(ESP32)
+    slab = (uint8_t *)heap_caps_aligned_alloc(SVF_ARENA_ALIGN, bytes, MALLOC_CAP_DMA);
+    #else
+    slab = (uint8_t *)aligned_alloc(SVF_ARENA_ALIGN, bytes);
+    #endif
+    if(slab != NULL)
+      break;
+  }
+  return slab;
+}
+
+static void slab_free(uint8_t *slab)
+{
+  #if defined(ESP32)
+  heap_caps_free(slab);
+  #else
+  free(slab);
+  #endif
+}
+
+uint8_t *svfarena_get(struct S_svfarena *arena)
+{
+  uint8_t *chunk = arena->free;
+  if(chunk == NULL)
+  {
+    // free list is empty, carve a new slab
+    uint32_t chunks;
+    uint8_t *slab = slab_alloc(&chunks);
+    if(slab == NULL)
+      return NULL;
+    arena->heap_calls++;
+    memcpy(slab, &arena->slab, sizeof(uint8_t *));
+    arena->slab = slab;
+    for(int i = chunks-1; i >= 0; i--)
+      svfarena_put(arena, slab + SLAB_HEADER + i * SVF_ARENA_CHUNK_BYTES);
+    arena->chunks_used += chunks; // put above counted them as released
+    arena->chunks_total += chunks;
+    chunk = arena->free;
+  }
+  memcpy(&arena->free, chunk, sizeof(uint8_t *));
+  arena->chunks_used++;
+  if(arena->chunks_used > arena->chunks_high)
+    arena->chunks_high = arena->chunks_used;
+  return chunk;
+}
+
+void svfarena_put(struct S_svfarena *arena, uint8_t *chunk)
+{
+  memcpy(chunk, &arena->free, sizeof(uint8_t *));
+  arena->free = chunk;
+  arena->chunks_used--;
+}
+
+void svfarena_free(struct S_svfarena *arena)
+{
+  while(arena->slab != NULL)
+  {
+    uint8_t *slab = arena->slab;
+    memcpy(&arena->slab, slab, sizeof(uint8_t *));
+    slab_free(slab);
+  }
+  arena->free = NULL;
+  arena->chunks_total = 0;
+  arena->chunks_used = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef SVFARENA_H
+#define SVFARENA_H
+
+#include <stdint.h>
+
+/*
+arena for bitfield chunks.
+
+chunks are carved from slabs of SVF_ARENA_SLAB_CHUNKS,
+aligned to SVF_ARENA_ALIGN (cache line, DMA capable on ESP32).
+released chunks go to a free list and are handed out again,
+so once the largest command was seen, parsing does no
+more heap calls. slabs are freed only by svfarena_free().
+when a slab can't be allocated, slabs of half as many
+chunks are tried, down to one chunk.
+
+every bitfield takes at least one chunk: ESP32 defaults
+are small so short fields (SIR) don't hold kilobytes.
+*/
+
+// chunk size, same as bitfield chunk, at least SVFCACHE_MAX_BYTES
+#ifndef SVF_ARENA_CHUNK_BYTES
+#if defined(ESP32)
+#define SVF_ARENA_CHUNK_BYTES 512
+#else
+#define SVF_ARENA_CHUNK_BYTES 4096
+#endif
+#endif
+// chunks per slab
+#ifndef SVF_ARENA_SLAB_CHUNKS
+#if defined(ESP32)
+#define SVF_ARENA_SLAB_CHUNKS 8
+#else
+#define SVF_ARENA_SLAB_CHUNKS 16
+#endif
+#endif
+// alignment of slabs and chunks
+#define SVF_ARENA_ALIGN 64
+
+struct S_svfarena
+{
+  uint8_t *free; // free chunks, linked through their first bytes
+  uint8_t *slab; // slabs, linked through their headers
+  uint32_t chunks_total; // chunks in all slabs
+  uint32_t chunks_used; // chunks handed out
+  uint32_t chunks_high; // high-water mark of chunks_used
+  uint32_t heap_calls; // slab allocations done
+};
+
+// take a chunk, NULL if out of memory
+uint8_t *svfarena_get(struct S_svfarena *arena);
+// give the chunk back for reuse
+void svfarena_put(struct S_svfarena *arena, uint8_t *chunk);
+// release all slabs, all chunks must be back
+void svfarena_free(struct S_svfarena *arena);
+
+#endif
@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "svfparser.h"
+#include "svfinput.h"
+#include "svfpipe.h"
+
+// benchmark of the input paths and the parser stages:
+// fread packets versus mmap of the whole file, packets
+// with scans shifted by the driver thread, then time of
+// each stage (built with SVF_PROFILE) of the best packets
+// run. backend is the simulated target (jtaghw_sim),
+// parser output is disabled (built with DBG_PRINT=0).
+// inputs come from svfgen or any svf, optionally repeated
+// into a temporary file of requested size.
+// results can be written to a baseline file and later
+// runs on the same machine compared with it. baselines
+// hold this host's absolute speed, they are not shared
+
+#define BENCH_RUNS 3
+// slower than baseline by more than this is a regression
+#define BENCH_TOLERANCE 0.20
+// shorter measurements are shown but not compared,
+// timer and scheduler noise is too large a part of them
+#define BENCH_MIN_SECONDS 0.1
+#define BENCH_RESULTS_MAX 64
+
+static const char *Stage_name[STAGE_NUM] =
+{
+  [STAGE_LEXER] = "lexer",
+  [STAGE_DISPATCH] = "dispatch",
+  [STAGE_HEX] = "hex",
+  [STAGE_SPLIT] = "split",
+  [STAGE_BACKEND] = "backend",
+};
+
+struct S_result
+{
+  char name[32]; // input
+  char measure[16]; // input path or stage
+  double seconds;
+  double mbs, scans; // per second
+};
+
+static struct S_result Results[BENCH_RESULTS_MAX];
+static int Nresults;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// repeat content of filename into tmpname up to megabytes
+static long make_input(char *filename, char *tmpname, long megabytes)
+{
+  FILE *fp = fopen(filename, "rb");
+  if(fp == NULL)
+  {
+    printf("can't open %s\n", filename);
+    return -1;
+  }
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  char *content = (char *) malloc(size + 1);
+  size = fread(content, 1, size, fp);
+  fclose(fp);
+  content[size] = '\n'; // separate repeated copies
+  int fd = mkstemp(tmpname);
+  if(fd < 0 || size == 0)
+  {
+    free(content);
+    return -1;
+  }
+  long total = 0;
+  while(total < megabytes * 1024 * 1024)
+  {
+    if(write(fd, content, size + 1) != size + 1)
+      break;
+    total += size + 1;
+  }
+  close(fd);
+  free(content);
+  return total;
+}
+
+static long file_size(char *filename)
+{
+  FILE *fp = fopen(filename, "rb");
+  if(fp == NULL)
+  {
+    printf("can't open %s\n", filename);
+    return -1;
+  }
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fclose(fp);
+  return size;
+}
+
+static void result(const char *name, const char *measure, double seconds, double bytes, double scans)
+{
+  struct S_result *r = &Results[Nresults];
+  if(Nresults == BENCH_RESULTS_MAX)
+    return;
+  Nresults++;
+  snprintf(r->name, sizeof(r->name), "%s", name);
+  snprintf(r->measure, sizeof(r->measure), "%s", measure);
+  r->seconds = seconds;
+  r->mbs = seconds > 0 ? bytes / seconds / (1024 * 1024) : 0;
+  r->scans = seconds > 0 ? scans / seconds : 0;
+  printf("  %-9s %8.3f s %9.1f MB/s %11.0f scans/s\n", measure, seconds, r->mbs, r->scans);
+}
+
+// all measurements of one input
+static void bench(const char *name, char *filename, long total)
+{
+  struct S_svfparser svf;
+  struct S_svfpipe pipe;
+  struct S_svfprofile profile = {};
+  struct S_svfstats stats;
+  double best_packets = 1e9, best_mmap = 1e9, best_pipe = 1e9, t;
+  uint32_t scans = 0;
+  for(int run = 0; run < BENCH_RUNS; run++)
+  {
+    svf_init(&svf);
+    t = now();
+    svf_read_packets(&svf, filename, SVF_PACKET_SIZE);
+    t = now() - t;
+    if(t < best_packets)
+    {
+      best_packets = t;
+      profile = svf.profile;
+    }
+    scans = svf.scans;
+    svfstats_get(&svf, &stats);
+    svf_free(&svf);
+    svf_init(&svf);
+    t = now();
+    svf_read_mmap(&svf, filename);
+    t = now() - t;
+    svf_free(&svf);
+    if(t < best_mmap)
+      best_mmap = t;
+    svf_init(&svf);
+    t = now();
+    svfpipe_start(&pipe, &svf.verify, &svf.stats.shift, &svf.stats.reallocs);
+    svf.pipe = &pipe;
+    svf_read_packets(&svf, filename, SVF_PACKET_SIZE);
+    svfpipe_stop(&pipe);
+    t = now() - t;
+    svf_free(&svf);
+    if(t < best_pipe)
+      best_pipe = t;
+  }
+  printf("%s: %ld bytes, %u scans, best of %d runs\n", name, total, scans, BENCH_RUNS);
+  result(name, "packets", best_packets, total, scans);
+  result(name, "mmap", best_mmap, total, scans);
+  result(name, "pipe", best_pipe, total, scans);
+  // hit rates, the same on every run
+  printf("  cache     value %u/%u hits, scan %u/%u hits\n",
+    stats.value_hits, stats.value_hits + stats.value_misses,
+    stats.scan_hits, stats.scan_hits + stats.scan_misses);
+  // ticks to seconds: stages cover the parse of the best run
+  uint64_t ticks = 0;
+  for(int i = 0; i < STAGE_NUM; i++)
+    ticks += profile.ticks[i];
+  if(ticks == 0)
+    return; // built without SVF_PROFILE
+  for(int i = 0; i < STAGE_NUM; i++)
+    result(name, Stage_name[i], best_packets * profile.ticks[i] / ticks, profile.bytes[i], scans);
+}
+
+// compare results with baseline file
+// only measurements of BENCH_MIN_SECONDS or more count
+// return value: number of regressions, -1 if no baseline
+static int compare(const char *filename)
+{
+  FILE *fp = fopen(filename, "r");
+  char name[32], measure[16];
+  double mbs, scans;
+  int regressions = 0;
+  if(fp == NULL)
+  {
+    printf("can't open %s\n", filename);
+    return -1;
+  }
+  printf("compared with %s:\n", filename);
+  while(fscanf(fp, "%31s %15s %lf %lf", name, measure, &mbs, &scans) == 4)
+  {
+    for(int j = 0; j < Nresults; j++)
+    {
+      struct S_result *r = &Results[j];
+      if(strcmp(r->name, name) != 0 || strcmp(r->measure, measure) != 0 || mbs <= 0)
+        continue;
+      double ratio = r->mbs / mbs;
+      uint8_t gated = r->seconds >= BENCH_MIN_SECONDS;
+      uint8_t slow = gated && ratio < 1 - BENCH_TOLERANCE;
+      printf("  %-8s %-9s %+6.1f%%%s\n", name, measure, 100 * (ratio - 1),
+        slow ? "  REGRESSION" : gated ? "" : "  (too short, not compared)");
+      regressions += slow;
+    }
+  }
+  fclose(fp);
+  return regressions;
+}
+
+static int write_baseline(const char *filename)
+{
+  FILE *fp = fopen(filename, "w");
+  if(fp == NULL)
+  {
+    printf("can't create %s\n", filename);
+    return -1;
+  }
+  for(int j = 0; j < Nresults; j++)
+    fprintf(fp, "%s %s %.1f %.0f\n", Results[j].name, Results[j].measure, Results[j].mbs, Results[j].scans);
+  fclose(fp);
+  printf("baseline written to %s\n", filename);
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *baseline = NULL;
+  uint8_t store = 0;
+  long megabytes = 0;
+  int opt;
+  while((opt = getopt(argc, argv, "b:w:s:")) != -1)
+  {
+    if(opt == 'b' || opt == 'w')
+    {
+      baseline = optarg;
+      store = opt == 'w';
+    }
+    else if(opt == 's')
+      megabytes = atol(optarg);
+    else
+      optind = argc + 1;
+  }
+  if(optind >= argc)
+  {
+    printf("usage: %s [-b baseline | -w baseline] [-s megabytes] [name:]file.svf ...\n", argv[0]);
+    return 1;
+  }
+  for(int j = optind; j < argc; j++)
+  {
+    // name:file, name defaults to the file
+    char name[32], *filename = strchr(argv[j], ':');
+    if(filename != NULL)
+      snprintf(name, sizeof(name), "%.*s", (int)(filename++ - argv[j]), argv[j]);
+    else
+      snprintf(name, sizeof(name), "%s", filename = argv[j]);
+    if(megabytes > 0)
+    {
+      // small svf repeated to the size
+      char tmpname[] = "/tmp/svfbenchXXXXXX";
+      long total = make_input(filename, tmpname, megabytes);
+      if(total > 0)
+        bench(name, tmpname, total);
+      unlink(tmpname);
+    }
+    else
+    {
+      long total = file_size(filename);
+      if(total > 0)
+        bench(name, filename, total);
+    }
+  }
+  if(baseline == NULL)
+    return 0;
+  if(store)
+    return write_baseline(baseline) < 0 ? 1 : 0;
+  return compare(baseline) != 0 ? 1 : 0;
+}
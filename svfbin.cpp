@@ -0,0 +1,262 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "svfparser.h"
+#include "svfbin.h"
+#include "jtaghw.h"
+
+#ifndef DBG_PRINT
+#define DBG_PRINT 1
+#endif
+#if DBG_PRINT
+#define PRINTF(f_, ...) printf((f_), ##__VA_ARGS__)
+#else
+#define PRINTF(f_, ...)
+#endif
+
+/* ******************* COMPILER (svfparser sink) ******************* */
+
+static void put32(uint8_t *p, uint32_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static uint32_t get32(uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void compile_scan(void *user, uint8_t ir, uint32_t length, uint8_t *tdi, uint8_t *tdo, uint8_t *mask, uint8_t endstate)
+{
+  uint8_t op[7];
+  uint32_t bytes = (length+7)/8;
+  op[0] = ir ? SVFB_SIR : SVFB_SDR;
+  op[1] = tdo ? SVFB_F_TDO : 0;
+  op[2] = endstate;
+  put32(op+3, length);
+  fwrite(op, 1, sizeof(op), (FILE *)user);
+  fwrite(tdi, 1, bytes, (FILE *)user);
+  if(tdo)
+  {
+    fwrite(tdo, 1, bytes, (FILE *)user);
+    fwrite(mask, 1, bytes, (FILE *)user);
+  }
+}
+
+static void compile_state(void *user, uint8_t *path, uint8_t n)
+{
+  uint8_t op[2] = { SVFB_STATE, n };
+  fwrite(op, 1, sizeof(op), (FILE *)user);
+  fwrite(path, 1, n, (FILE *)user);
+}
+
+static void compile_runtest(void *user, uint8_t runstate, uint32_t count, uint32_t min_us, uint8_t endstate)
+{
+  uint8_t op[11];
+  op[0] = SVFB_RUNTEST;
+  op[1] = runstate;
+  op[2] = endstate;
+  put32(op+3, count);
+  put32(op+7, min_us);
+  fwrite(op, 1, sizeof(op), (FILE *)user);
+}
+
+int svfbin_compile_open(struct S_svfparser *ctx, struct S_svf_sink *sink, FILE *fp)
+{
+  uint8_t header[SVFB_HEADER_LEN] = { 'S', 'V', 'F', 'B', SVFB_VERSION,
+    (uint8_t)(ctx->msb_first ? SVFB_H_REVERSE_NIBBLE : 0), 0, 0 };
+  if(fp == NULL)
+    return -1;
+  fwrite(header, 1, sizeof(header), fp);
+  sink->scan = compile_scan;
+  sink->state = compile_state;
+  sink->runtest = compile_runtest;
+  sink->user = fp;
+  ctx->sink = sink;
+  return 0;
+}
+
+int svfbin_compile_close(struct S_svfparser *ctx)
+{
+  uint8_t op = SVFB_END;
+  if(ctx->sink == NULL)
+    return -1;
+  fwrite(&op, 1, 1, (FILE *)ctx->sink->user);
+  ctx->sink = NULL;
+  return 0;
+}
+
+/* ******************* REPLAY ******************* */
+
+// describe length bits at mem for the bitbanger
+static void replay_descriptor(struct S_jtaghw *hw, uint8_t *mem, uint32_t length)
+{
+  hw->header = NULL;
+  hw->header_bits = 0;
+  hw->data = length >= 8 ? mem : NULL;
+  hw->data_bytes = length/8;
+  hw->trailer = (length & 7) != 0 ? mem + length/8 : NULL;
+  hw->trailer_bits = length & 7;
+  hw->fill = 0;
+  hw->next = NULL;
+  hw->tms_exit = 0;
+  hw->tms_post = 0;
+  hw->tms_post_bits = 0;
+}
+
+// TAP state byte of the stream, INIT is never compiled
+static uint8_t replay_state(uint8_t state)
+{
+  return state > LIBXSVF_TAP_INIT && state < LIBXSVF_TAP_NUM;
+}
+
+static void replay_tms(void *user, uint8_t *tms, uint32_t bits)
+{
+  jtag_tms(tms, bits);
+}
+
+int8_t svfbin_replay(uint8_t *stream, uint32_t length)
+{
+  uint8_t *p = stream + SVFB_HEADER_LEN;
+  uint8_t *end = stream + length;
+  uint8_t *capture = NULL;
+  uint32_t capture_allocated = 0;
+  uint32_t max_transfer = jtag_max_transfer();
+  struct S_svfscan_buf chunks;
+  uint8_t reverse;
+  int8_t result = -1;
+  struct S_jtaghw tdi, tdo;
+  struct S_svftap tap;
+  struct S_svfverify verify;
+  uint32_t scans = 0, ops = 0;
+
+  if(length < SVFB_HEADER_LEN || memcmp(stream, SVFB_MAGIC, 4) != 0 || stream[4] != SVFB_VERSION)
+  {
+    PRINTF("not a compiled svf stream\n");
+    return -1;
+  }
+  // stream compiled for other bit order is converted in place
+  reverse = ((stream[5] & SVFB_H_REVERSE_NIBBLE) != 0) != jtag_msb_first();
+  memset(&verify, 0, sizeof(verify));
+  memset(&chunks, 0, sizeof(chunks));
+  verify.msb_first = jtag_msb_first();
+  verify.off = !jtag_tdo_valid();
+  jtag_open();
+  svftap_init(&tap, replay_tms, NULL);
+  while(p < end)
+  {
+    uint8_t op = *p++;
+    ops++;
+    if(op == SVFB_END)
+    {
+      result = 0;
+      break;
+    }
+    if(op == SVFB_SIR || op == SVFB_SDR)
+    {
+      if(end - p < 6)
+        break;
+      uint8_t flags = p[0];
+      uint8_t endstate = p[1];
+      uint32_t bits = get32(p+2);
+      uint32_t bytes = (bits+7)/8;
+      uint32_t fields = (flags & SVFB_F_TDO) != 0 ? 3 : 1;
+      p += 6;
+      if((uint64_t)(end - p) < (uint64_t)fields * bytes || !replay_state(endstate))
+        break;
+      if(reverse)
+        svfscan_reverse(p, fields * bytes);
+      if(bytes > capture_allocated)
+      {
+        capture = (uint8_t *)realloc(capture, bytes);
+        if(capture == NULL)
+        {
+          PRINTF("Memory Allocation Failed\n");
+          capture_allocated = 0;
+          break;
+        }
+        capture_allocated = bytes;
+      }
+      replay_descriptor(&tdi, p, bits);
+      replay_descriptor(&tdo, capture, bits);
+      svftap_goto(&tap, op == SVFB_SIR ? LIBXSVF_TAP_IRSHIFT : LIBXSVF_TAP_DRSHIFT);
+      svftap_flush(&tap);
+      if(bits > 0)
+      {
+        // last bit leaves Shift, backend walks on to endstate
+        int8_t post = svftap_exit(&tap, endstate, &tdi.tms_post);
+        tdi.tms_exit = post >= 0;
+        tdi.tms_post_bits = post > 0 ? post : 0;
+        if(flags & SVFB_F_TDO)
+          jtag_expect(p + bytes, p + 2*bytes, bits);
+        else
+          jtag_expect(NULL, NULL, 0);
+        if(svfscan_shift(&chunks, &tdi, &tdo, max_transfer) < 0)
+        {
+          PRINTF("Memory Allocation Failed\n");
+          break;
+        }
+        scans++;
+        if((flags & SVFB_F_TDO) && !verify.off)
+        {
+          // stream has expected TDO and MASK after TDI
+          // op index as command, no SVF line
+          struct S_svfcheck check = { scans, ops, 0, bits, p + bytes, p + 2*bytes };
+          svfverify_scan(&verify, &tdo, &check);
+        }
+      }
+      svftap_goto(&tap, endstate);
+      p += fields * bytes;
+      continue;
+    }
+    if(op == SVFB_STATE)
+    {
+      if(end - p < 1 || end - p < 1 + p[0])
+        break;
+      uint8_t j;
+      for(j = 0; j < p[0] && replay_state(p[1+j]); j++);
+      if(j < p[0])
+        break;
+      svftap_path(&tap, p+1, p[0]);
+      p += 1 + p[0];
+      continue;
+    }
+    if(op == SVFB_RUNTEST)
+    {
+      if(end - p < 10 || !replay_state(p[0]) || !replay_state(p[1]))
+        break;
+      svftap_goto(&tap, p[0]);
+      if(svftap_next(tap.state, 0) == tap.state || svftap_next(tap.state, 1) == tap.state)
+      {
+        svftap_flush(&tap);
+        jtag_runtest(tap.state, get32(p+2), get32(p+6));
+      }
+      svftap_goto(&tap, p[1]);
+      p += 10;
+      continue;
+    }
+    PRINTF("unknown op %d\n", op);
+    break;
+  }
+  svftap_flush(&tap);
+  jtag_close();
+  free(capture);
+  svfscan_free(&chunks);
+  if(verify.off)
+    PRINTF("verify: backend reads no TDO, not checked\n");
+  else if(verify.failures)
+    PRINTF("verify: %u of %u scans failed, first scan %u op %u bit %u\n", verify.failures, verify.scans,
+      verify.first_scan, verify.first_command, verify.first_bit);
+  else
+    PRINTF("verify: %u scans ok\n", verify.scans);
+  if(result < 0)
+    PRINTF("compiled stream truncated or malformed\n");
+  else if(verify.failures > 0)
+    result = -1; // like a failed check of the svf
+  svfverify_free(&verify);
+  return result;
+}
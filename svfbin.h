@@ -0,0 +1,49 @@
+#ifndef SVFBIN_H
+#define SVFBIN_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "svfparser.h"
+
+/*
+compiled SVF: binary stream of jtag operations,
+replayed without any text parsing.
+
+header: "SVFB", u8 version, u8 flags, u16 reserved
+then ops, each starting with u8 opcode.
+multibyte integers are little endian.
+bit sequences are (length+7)/8 bytes in shift order.
+*/
+
+#define SVFB_MAGIC "SVFB"
+#define SVFB_VERSION 1
+#define SVFB_HEADER_LEN 8
+
+// header flags
+#define SVFB_H_REVERSE_NIBBLE 0x01 // bytes are bit-reversed (MSB shifted first)
+
+// scan flags
+#define SVFB_F_TDO 0x01 // expected TDO and MASK follow TDI
+
+enum svfbin_opcode
+{
+  SVFB_END = 0, // end of stream
+  SVFB_SIR, // u8 flags, u8 endstate, u32 length, TDI[, TDO, MASK]
+  SVFB_SDR, // same as SIR
+  SVFB_STATE, // u8 n, n * u8 state
+  SVFB_RUNTEST, // u8 runstate, u8 endstate, u32 count, u32 min_us
+  SVFB_NUM
+};
+
+// compile: svfparser output is written to fp as op stream.
+// sink is filled in and must live until close
+int svfbin_compile_open(struct S_svfparser *ctx, struct S_svf_sink *sink, FILE *fp);
+int svfbin_compile_close(struct S_svfparser *ctx);
+
+// play compiled stream to jtag hardware
+// return value:
+// 0 - finished OK
+// -1 - malformed stream or TDO check failed
+int8_t svfbin_replay(uint8_t *stream, uint32_t length);
+
+#endif
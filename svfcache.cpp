@@ -0,0 +1,117 @@
+#include <string.h>
+#include "svfcache.h"
+
+// multiplicative hash, 8 bytes per step, never 0 (0 marks empty entry)
+static uint32_t cache_hash(uint32_t seed, const uint8_t *p, uint32_t n)
+{
+  uint64_t h = seed, w;
+  for(; n >= 8; n -= 8, p += 8)
+  {
+    memcpy(&w, p, 8);
+    h = (h ^ w) * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 29;
+  }
+  if(n > 0)
+  {
+    w = 0;
+    memcpy(&w, p, n);
+    h = (h ^ w ^ ((uint64_t)n << 56)) * 0x9E3779B97F4A7C15ull;
+  }
+  h ^= h >> 32;
+  return (uint32_t)h != 0 ? (uint32_t)h : 1;
+}
+
+static uint32_t key_hash(uint8_t a, uint8_t b, uint32_t length, int32_t index)
+{
+  uint8_t key[10] = { a, b };
+  memcpy(key+2, &length, 4);
+  memcpy(key+6, &index, 4);
+  return cache_hash(0, key, sizeof(key));
+}
+
+uint8_t *svfcache_value_get(struct S_svfcache *cache, uint8_t command, uint8_t field,
+  uint32_t length, const uint8_t *text, uint32_t textlen)
+{
+  if(textlen > SVFCACHE_MAX_DIGITS || (length+7)/8 > SVFCACHE_MAX_BYTES)
+    return NULL;
+  uint32_t hash = cache_hash(key_hash(command, field, length, 0), text, textlen);
+  struct S_svfcache_value *v = &cache->value[hash & (SVFCACHE_ENTRIES-1)];
+  if(v->hash == hash && v->command == command && v->field == field && v->length == length
+  && v->textlen == textlen && memcmp(v->text, text, textlen) == 0)
+  {
+    cache->value_hits++;
+    return v->bytes;
+  }
+  return NULL;
+}
+
+void svfcache_value_put(struct S_svfcache *cache, uint8_t command, uint8_t field,
+  uint32_t length, const uint8_t *text, uint32_t textlen, uint8_t *bytes, uint32_t n)
+{
+  if(textlen > SVFCACHE_MAX_DIGITS || n > SVFCACHE_MAX_BYTES)
+    return;
+  uint32_t hash = cache_hash(key_hash(command, field, length, 0), text, textlen);
+  struct S_svfcache_value *v = &cache->value[hash & (SVFCACHE_ENTRIES-1)];
+  cache->value_misses++;
+  v->hash = hash;
+  v->command = command;
+  v->field = field;
+  v->length = length;
+  v->textlen = textlen;
+  memcpy(v->text, text, textlen);
+  memcpy(v->bytes, bytes, n);
+}
+
+struct S_jtaghw *svfcache_scan_get(struct S_svfcache *cache, uint8_t flags,
+  uint32_t length, int32_t digitindex, uint8_t *bytes, uint32_t n, struct S_svfcache_scan **slot)
+{
+  *slot = NULL;
+  if(n > SVFCACHE_MAX_BYTES)
+    return NULL;
+  uint32_t hash = cache_hash(key_hash(flags, 0, length, digitindex), bytes, n);
+  struct S_svfcache_scan *e = &cache->scan[hash & (SVFCACHE_ENTRIES-1)];
+  if(e->hash == hash && e->flags == flags && e->length == length
+  && e->digitindex == digitindex && e->n == n && memcmp(e->key, bytes, n) == 0)
+  {
+    cache->scan_hits++;
+    return &e->tdi[0];
+  }
+  // claim the entry, it is valid after svfcache_scan_put()
+  cache->scan_misses++;
+  e->flags = flags;
+  e->length = length;
+  e->digitindex = digitindex;
+  e->n = n;
+  memcpy(e->key, bytes, n);
+  e->hash = hash;
+  *slot = e;
+  return NULL;
+}
+
+void svfcache_scan_put(struct S_svfcache_scan *slot, struct S_jtaghw *tdi, uint8_t *bytes)
+{
+  int i;
+  memcpy(slot->bytes, bytes, slot->n);
+  for(i = 0; tdi != NULL; i++, tdi = tdi->next)
+  {
+    if(i == SVFCACHE_SEGS)
+    {
+      slot->hash = 0;
+      return;
+    }
+    struct S_jtaghw *hw = &slot->tdi[i];
+    *hw = *tdi;
+    if(i > 0)
+      slot->tdi[i-1].next = hw;
+    hw->next = NULL;
+    if(tdi->fill)
+      continue; // shared page stays
+    // rebase pointers from the field to the copy
+    if(tdi->header != NULL)
+      hw->header = slot->bytes + (tdi->header - bytes);
+    if(tdi->data != NULL)
+      hw->data = slot->bytes + (tdi->data - bytes);
+    if(tdi->trailer != NULL)
+      hw->trailer = slot->bytes + (tdi->trailer - bytes);
+  }
+}
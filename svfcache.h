@@ -0,0 +1,74 @@
+#ifndef SVFCACHE_H
+#define SVFCACHE_H
+
+#include <stdint.h>
+#include "jtaghw.h"
+
+/*
+content addressed cache for short repeated scans
+(same SIR instruction, same short SDR again and again).
+
+value cache: hex text of a bitfield -> decoded field bytes,
+  keyed by (command, field, length, text), skips the decode.
+scan cache: TDI bytes -> split S_jtaghw descriptor,
+  keyed by (TDO given, length, given digits, TDI bytes),
+  skips the header/data/trailer split.
+
+both are direct mapped, a new entry replaces the old one.
+*/
+
+// entries per cache, must be power of 2
+#define SVFCACHE_ENTRIES 32
+// only fields up to this size are cached
+#define SVFCACHE_MAX_BYTES 64
+#define SVFCACHE_MAX_DIGITS (2*SVFCACHE_MAX_BYTES)
+// segments of a cached scan: field bytes and padding
+#define SVFCACHE_SEGS 2
+
+struct S_svfcache_value
+{
+  uint32_t hash; // 0 if empty
+  uint8_t command, field;
+  uint32_t length;
+  uint32_t textlen;
+  uint8_t text[SVFCACHE_MAX_DIGITS]; // hex digits as they came
+  uint8_t bytes[SVFCACHE_MAX_BYTES]; // field bytes after decoding them
+};
+
+struct S_svfcache_scan
+{
+  uint32_t hash; // 0 if empty
+  uint8_t flags;
+  uint32_t length;
+  int32_t digitindex;
+  uint32_t n; // bytes in key and bytes
+  uint8_t key[SVFCACHE_MAX_BYTES]; // TDI bytes before play
+  uint8_t bytes[SVFCACHE_MAX_BYTES]; // TDI bytes as played, tdi points here
+  struct S_jtaghw tdi[SVFCACHE_SEGS];
+};
+
+struct S_svfcache
+{
+  struct S_svfcache_value value[SVFCACHE_ENTRIES];
+  struct S_svfcache_scan scan[SVFCACHE_ENTRIES];
+  uint32_t value_hits, value_misses;
+  uint32_t scan_hits, scan_misses;
+};
+
+// decoded field bytes for the hex text, NULL if not cached
+uint8_t *svfcache_value_get(struct S_svfcache *cache, uint8_t command, uint8_t field,
+  uint32_t length, const uint8_t *text, uint32_t textlen);
+// remember n decoded field bytes for the hex text
+void svfcache_value_put(struct S_svfcache *cache, uint8_t command, uint8_t field,
+  uint32_t length, const uint8_t *text, uint32_t textlen, uint8_t *bytes, uint32_t n);
+
+// descriptor prepared earlier from the same n TDI bytes.
+// on a miss NULL is returned and *slot is claimed
+// to be filled by svfcache_scan_put() after the split
+struct S_jtaghw *svfcache_scan_get(struct S_svfcache *cache, uint8_t flags,
+  uint32_t length, int32_t digitindex, uint8_t *bytes, uint32_t n, struct S_svfcache_scan **slot);
+// copy split descriptor chain tdi pointing into bytes to the slot,
+// a chain longer than SVFCACHE_SEGS leaves the slot empty
+void svfcache_scan_put(struct S_svfcache_scan *slot, struct S_jtaghw *tdi, uint8_t *bytes);
+
+#endif
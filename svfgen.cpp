@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+// synthetic SVF for benchmarks, written to stdout.
+// shapes:
+//   big    - few SDRs of several MB each
+//   pairs  - thousands of short SIR/SDR pairs
+//   vendor - comment-heavy vendor style, wrapped values
+//   odd    - odd bit lengths (21, 29, 37, ...) with HDR/TDR
+// expected TDO is what the default jtaghw_sim chain
+// (jtaghw_sim.h) answers, so all checks pass there
+
+#define GEN_IDCODE 0x41112043
+#define GEN_IDCODE_OP 0xE0
+#define GEN_CFG_OP 0x7A
+#define GEN_BIG_BYTES (4 * 1024 * 1024) // hex text of one big SDR
+#define GEN_LINE 80 // vendor value line length
+
+static uint64_t Seed = 1;
+static uint64_t Written;
+
+static uint32_t rnd()
+{
+  // xorshift64
+  Seed ^= Seed << 13;
+  Seed ^= Seed >> 7;
+  Seed ^= Seed << 17;
+  return Seed >> 32;
+}
+
+static void out(const char *f, ...) __attribute__((format(printf, 1, 2)));
+static void out(const char *f, ...)
+{
+  va_list ap;
+  va_start(ap, f);
+  int n = vprintf(f, ap);
+  va_end(ap);
+  if(n > 0)
+    Written += n;
+}
+
+// random hex value of bits, most significant digit first,
+// lines of wrap chars (0: one line), lower case if lower
+static void hex_random(uint32_t bits, uint32_t wrap, uint8_t lower)
+{
+  static const char *digits[2] = { "0123456789ABCDEF", "0123456789abcdef" };
+  char line[GEN_LINE+1];
+  uint32_t n = (bits+3)/4, len = 0, r = 0;
+  for(uint32_t j = 0; j < n; j++)
+  {
+    if((j & 7) == 0)
+      r = rnd();
+    uint8_t d = r & 0xF;
+    r >>= 4;
+    if(j == 0 && (bits & 3) != 0)
+      d &= 0xF >> (4 - (bits & 3)); // top digit within the length
+    line[len++] = digits[lower != 0][d];
+    if(len == GEN_LINE || j == n-1)
+    {
+      Written += fwrite(line, 1, len, stdout);
+      len = 0;
+      if(wrap != 0 && j != n-1)
+        out("\n\t\t\t ");
+    }
+  }
+}
+
+// n low bits of v as hex, n can exceed 32 (zeros above)
+static void hex_value(uint32_t bits, uint64_t v, uint8_t lower)
+{
+  for(int32_t d = (bits+3)/4-1; d >= 0; d--)
+  {
+    uint8_t x = d < 16 ? (v >> (4*d)) & 0xF : 0;
+    if(4*(uint32_t)d + 4 > bits)
+      x &= 0xF >> (4*d + 4 - bits);
+    out(lower ? "%x" : "%X", x);
+  }
+}
+
+static void gen_big(uint64_t total)
+{
+  out("! big SDRs\nSTATE RESET;\nSIR 8 TDI (%02X);\n", GEN_CFG_OP);
+  while(Written < total)
+  {
+    uint64_t left = total - Written;
+    uint32_t bytes = left < GEN_BIG_BYTES ? left : GEN_BIG_BYTES;
+    uint32_t bits = 4 * bytes + 1 + rnd() % 3;
+    out("SDR %u TDI (", bits);
+    hex_random(bits, 0, 0);
+    out(");\n");
+  }
+}
+
+static void gen_pairs(uint64_t total)
+{
+  out("! short SIR/SDR pairs\nSTATE RESET;\n");
+  while(Written < total)
+  {
+    out("SIR 8 TDI (%02X);\nSDR 32 TDI (", GEN_IDCODE_OP);
+    hex_random(32, 0, 0);
+    out(") TDO (%08X) MASK (FFFFFFFF);\n", GEN_IDCODE);
+    out("SIR 8 TDI (FF);\nSDR 16 TDI (");
+    hex_random(16, 0, 0);
+    out(");\n");
+  }
+}
+
+static void gen_vendor(uint64_t total)
+{
+  out("! Lattice Semiconductor Corp.\n! Serial Vector Format (.SVF) File.\n"
+    "! User information:\n! Program Date: Mon Jan  1 00:00:00 2024\n\n"
+    "HDR\t0;\nHIR\t0;\nTDR\t0;\nTIR\t0;\nENDDR\tDRPAUSE;\nENDIR\tIRPAUSE;\n"
+    "! FREQUENCY\t1.00e+06 HZ;\nSTATE\tIDLE;\n");
+  for(uint32_t block = 0; Written < total; block++)
+  {
+    out("\n\n! Check the IDCODE\n\n! Shift in IDCODE_PUB(0x%02X) instruction\n", GEN_IDCODE_OP);
+    out("// device 1 of 1, row %u of the configuration memory\n", block);
+    out("SIR\t8\tTDI  (%02X);\nSDR\t32\tTDI  (00000000)\n\t\tTDO  (%08X)\n\t\tMASK (FFFFFFFF);\n",
+      GEN_IDCODE_OP, GEN_IDCODE);
+    out("\n\n! Program Fuse Map\n\n! Shift in LSC_BITSTREAM_BURST(0x%02X) instruction\n", GEN_CFG_OP);
+    out("SIR\t8\tTDI  (%02X);\nRUNTEST\tIDLE\t2 TCK\t1.00E-02 SEC;\n", GEN_CFG_OP);
+    out("! Shift in 8000 bits\n");
+    out("SDR\t8000\tTDI  (");
+    hex_random(8000, 1, 0);
+    out(");\n");
+  }
+}
+
+static void gen_odd(uint64_t total)
+{
+  static const uint32_t lengths[] = { 21, 29, 37, 1, 3, 5, 7, 9, 13, 17, 31, 33, 45, 63, 67 };
+  static const uint32_t heads[] = { 0, 1, 3, 5 };
+  static const uint32_t tails[] = { 0, 2, 7 };
+  out("! odd bit lengths\nSTATE RESET;\nsir 8 tdi (%02x);\n", GEN_IDCODE_OP);
+  for(uint32_t j = 0; Written < total; j++)
+  {
+    uint32_t n = lengths[j % (sizeof(lengths)/sizeof(lengths[0]))];
+    uint32_t h = heads[j % 4], t = tails[j % 3];
+    // IDCODE register: bits after the header come out, the
+    // TDI after it (from bit 32 on) is not checked
+    uint64_t tdo = (uint64_t)GEN_IDCODE >> h;
+    uint64_t mask = n < 32 ? ~0ull : 0xFFFFFFFFull;
+    out(h ? "hdr %u tdi (0);\n" : "hdr %u;\n", h);
+    out(t ? "tdr %u tdi (0);\n" : "tdr %u;\n", t);
+    out("sdr %u tdi (", n);
+    hex_random(n, 0, 1);
+    out(") tdo (");
+    hex_value(n, tdo, 1);
+    out(") mask (");
+    hex_value(n, mask, 1);
+    out(");\n");
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  if(argc < 3)
+  {
+    printf("usage: %s big|pairs|vendor|odd megabytes [seed] > file.svf\n", argv[0]);
+    return 1;
+  }
+  uint64_t total = (uint64_t)atol(argv[2]) * 1024 * 1024;
+  if(argc > 3)
+    Seed = strtoull(argv[3], NULL, 0) | 1;
+  if(strcmp(argv[1], "big") == 0)
+    gen_big(total);
+  else if(strcmp(argv[1], "pairs") == 0)
+    gen_pairs(total);
+  else if(strcmp(argv[1], "vendor") == 0)
+    gen_vendor(total);
+  else if(strcmp(argv[1], "odd") == 0)
+    gen_odd(total);
+  else
+  {
+    printf("unknown shape %s\n", argv[1]);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,197 @@
+#include <stdint.h>
+#include <string.h>
+#include "svfparser.h" // reversenibble
+#include "svfhex.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HEX_AVX2 1
+#else
+#define HEX_AVX2 0
+#endif
+
+// hex char to value 0-15, 0xFF if not hex
+static inline uint8_t hexval(uint8_t c)
+{
+  uint8_t d = c - '0';
+  if(d < 10)
+    return d;
+  d = (c | 0x20) - 'a';
+  if(d < 6)
+    return d + 10;
+  return 0xFF;
+}
+
+// two hex digits, first one more significant, as stored byte.
+// Msb: stored bit-reversed
+template<uint8_t Msb>
+static inline uint8_t hexbyte(uint8_t hi, uint8_t lo)
+{
+  if(Msb)
+    return (ReverseNibble[lo] << 4) | ReverseNibble[hi];
+  return (hi << 4) | lo;
+}
+
+#if defined(__SSE2__) || HEX_AVX2
+// store 8 decoded bytes (first decoded in lowest lane)
+// downwards in memory ending at dst[7], bit order as stored
+template<uint8_t Msb>
+static inline void store8_down(uint8_t *dst, uint64_t x)
+{
+  x = __builtin_bswap64(x);
+  if(Msb)
+  {
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+  }
+  memcpy(dst, &x, 8);
+}
+#endif
+
+#if defined(__SSE2__)
+// decode 16 hex chars into 8 bytes
+// return 0 if some char is not hex
+template<uint8_t Msb>
+static inline int decode16_sse2(const uint8_t *s, uint8_t *dst)
+{
+  __m128i c = _mm_loadu_si128((const __m128i *)s);
+  __m128i d = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+  __m128i l = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+  __m128i isd = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+  __m128i isl = _mm_cmpeq_epi8(_mm_min_epu8(l, _mm_set1_epi8(5)), l);
+  if(_mm_movemask_epi8(_mm_or_si128(isd, isl)) != 0xFFFF)
+    return 0;
+  __m128i v = _mm_or_si128(_mm_and_si128(isd, d),
+    _mm_andnot_si128(isd, _mm_add_epi8(l, _mm_set1_epi8(10))));
+  // pairs of nibbles in 16-bit lanes: first char is high nibble
+  __m128i w = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0x00FF)), 4),
+    _mm_srli_epi16(v, 8));
+  w = _mm_packus_epi16(w, w);
+  uint64_t x;
+  _mm_storel_epi64((__m128i *)&x, w);
+  store8_down<Msb>(dst, x);
+  return 1;
+}
+#endif
+
+#if HEX_AVX2
+// decode 32 hex chars into 16 bytes
+// return 0 if some char is not hex
+template<uint8_t Msb>
+__attribute__((target("avx2")))
+static int decode32_avx2(const uint8_t *s, uint8_t *dst)
+{
+  __m256i c = _mm256_loadu_si256((const __m256i *)s);
+  __m256i d = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+  __m256i l = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+  __m256i isd = _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d);
+  __m256i isl = _mm256_cmpeq_epi8(_mm256_min_epu8(l, _mm256_set1_epi8(5)), l);
+  if((uint32_t)_mm256_movemask_epi8(_mm256_or_si256(isd, isl)) != 0xFFFFFFFF)
+    return 0;
+  __m256i v = _mm256_blendv_epi8(_mm256_add_epi8(l, _mm256_set1_epi8(10)), d, isd);
+  __m256i w = _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(v, _mm256_set1_epi16(0x00FF)), 4),
+    _mm256_srli_epi16(v, 8));
+  w = _mm256_packus_epi16(w, w); // 8 bytes in low half of each 128-bit lane
+  if(Msb)
+  {
+    // bit-reverse each byte: nibbles looked up with pshufb
+    const __m256i rev = _mm256_setr_epi8(0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF,
+      0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF);
+    const __m256i low = _mm256_set1_epi8(0x0F);
+    __m256i lo = _mm256_shuffle_epi8(rev, _mm256_and_si256(w, low));
+    __m256i hi = _mm256_shuffle_epi8(rev, _mm256_and_si256(_mm256_srli_epi16(w, 4), low));
+    w = _mm256_or_si256(_mm256_slli_epi16(lo, 4), hi);
+  }
+  uint64_t x[4];
+  _mm256_storeu_si256((__m256i *)x, w);
+  store8_down<0>(dst + 8, x[0]);
+  store8_down<0>(dst, x[2]);
+  return 1;
+}
+#endif
+
+template<uint8_t Msb>
+static uint32_t hex_decode_t(uint8_t *field, int32_t digitindex, const uint8_t *s, uint32_t n)
+{
+  uint32_t j = 0;
+  int32_t k = digitindex;
+  uint8_t v;
+  if(k < 0)
+    return 0;
+  if(n > (uint32_t)k + 1)
+    n = k + 1;
+  if(n == 0)
+    return 0;
+  // odd nibble start: lower half of a byte
+  // whose upper half is already written
+  if((k & 1) == 0)
+  {
+    v = hexval(s[0]);
+    if(v == 0xFF)
+      return 0;
+    if(Msb)
+      field[k/2] = (field[k/2] & 0xF) | (ReverseNibble[v] << 4);
+    else
+      field[k/2] = (field[k/2] & 0xF0) | v;
+    j = 1;
+    k--;
+  }
+  // k is odd now: whole bytes from pairs of chars
+  #if HEX_AVX2
+  if(__builtin_cpu_supports("avx2"))
+  {
+    while(n - j >= 32 && decode32_avx2<Msb>(s + j, field + k/2 - 15))
+    {
+      j += 32;
+      k -= 32;
+    }
+  }
+  #endif
+  #if defined(__SSE2__)
+  while(n - j >= 16 && decode16_sse2<Msb>(s + j, field + k/2 - 7))
+  {
+    j += 16;
+    k -= 16;
+  }
+  #endif
+  while(n - j >= 2)
+  {
+    uint8_t hi = hexval(s[j]), lo = hexval(s[j+1]);
+    if(((hi | lo) & 0xF0) != 0)
+      break;
+    field[k/2] = hexbyte<Msb>(hi, lo);
+    j += 2;
+    k -= 2;
+  }
+  // last digit into upper half, with 4 bit leading zeros
+  if(j < n)
+  {
+    v = hexval(s[j]);
+    if(v != 0xFF)
+    {
+      field[k/2] = Msb ? ReverseNibble[v] : v << 4;
+      j++;
+    }
+  }
+  return j;
+}
+
+uint32_t hex_decode(uint8_t *field, int32_t digitindex, const uint8_t *s, uint32_t n, uint8_t msb_first)
+{
+  if(msb_first)
+    return hex_decode_t<1>(field, digitindex, s, n);
+  return hex_decode_t<0>(field, digitindex, s, n);
+}
+
+uint32_t hex_span(const uint8_t *s, uint32_t n)
+{
+  uint32_t j;
+  for(j = 0; j < n; j++)
+    if(hexval(s[j]) == 0xFF)
+      break;
+  return j;
+}
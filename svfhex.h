@@ -0,0 +1,17 @@
+#ifndef SVFHEX_H
+#define SVFHEX_H
+
+#include <stdint.h>
+
+// decode run of hex characters (any case) into bitfield storage.
+// first char is stored at digit (nibble) index digitindex,
+// following chars downwards, in the same nibble layout as
+// cmd_bitsequence, bit-reversed bytes when msb_first.
+// stops at first non-hex char or when digit index 0 is written.
+// return value: number of chars decoded
+uint32_t hex_decode(uint8_t *field, int32_t digitindex, const uint8_t *s, uint32_t n, uint8_t msb_first);
+
+// number of leading hex characters in s
+uint32_t hex_span(const uint8_t *s, uint32_t n);
+
+#endif
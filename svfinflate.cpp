@@ -0,0 +1,614 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "svfinflate.h"
+
+#ifndef DBG_PRINT
+#define DBG_PRINT 1
+#endif
+#if DBG_PRINT
+#define PRINTF(f_, ...) printf((f_), ##__VA_ARGS__)
+#else
+#define PRINTF(f_, ...)
+#endif
+
+// decoder states, gzip header fields first
+enum inflate_state
+{
+  ZS_HEADER = 0, // fixed 10 bytes
+  ZS_XLEN, // FEXTRA length
+  ZS_EXTRA, // FEXTRA bytes
+  ZS_NAME, // FNAME, zero terminated
+  ZS_COMMENT, // FCOMMENT, zero terminated
+  ZS_HCRC, // FHCRC
+  ZS_BLOCK, // 3 bit block header
+  ZS_STORED_LEN, // LEN, NLEN of a stored block
+  ZS_STORED, // stored bytes
+  ZS_TABLE_SIZES, // HLIT, HDIST, HCLEN of a dynamic block
+  ZS_CLEN, // code length code lengths
+  ZS_LENGTHS, // literal/length and distance code lengths
+  ZS_CODES, // compressed data
+  ZS_TRAILER, // CRC32, ISIZE
+  ZS_DONE,
+  ZS_ERROR
+};
+
+// gzip header flags
+#define GZ_FHCRC 2
+#define GZ_FEXTRA 4
+#define GZ_FNAME 8
+#define GZ_FCOMMENT 16
+
+// result of a decode step
+enum
+{
+  ZR_MORE = 0, // packet used up
+  ZR_END = 1, // gzip member complete
+  ZR_ERROR = -1
+};
+
+// CRC-32 (gzip) byte table, built at compile time
+struct S_crctable
+{
+  uint32_t t[256];
+};
+
+constexpr struct S_crctable crc_table()
+{
+  struct S_crctable c = {};
+  for(uint32_t n = 0; n < 256; n++)
+  {
+    uint32_t v = n;
+    for(int k = 0; k < 8; k++)
+      v = v & 1 ? 0xEDB88320u ^ (v >> 1) : v >> 1;
+    c.t[n] = v;
+  }
+  return c;
+}
+
+static constexpr struct S_crctable Crc = crc_table();
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *p, uint32_t n)
+{
+  uint32_t c = ~crc;
+  for(uint32_t j = 0; j < n; j++)
+    c = Crc.t[(c ^ p[j]) & 0xFF] ^ (c >> 8);
+  return ~c;
+}
+
+// length and distance symbols: base and extra bits
+static const uint16_t Len_base[29] =
+{
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t Len_extra[29] =
+{
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t Dist_base[30] =
+{
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t Dist_extra[30] =
+{
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+// order of the code length code lengths
+static const uint8_t Clen_order[19] =
+{
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// canonical code from the lengths of n symbols
+// return value:
+// 0 - ok, the code may be incomplete
+// -1 - more codes than lengths allow
+static int8_t huff_build(struct S_svfhuff *h, const uint8_t *lengths, uint32_t n)
+{
+  uint16_t offs[16], next[16];
+  int32_t left = 1;
+  uint32_t len, sym, code = 0;
+  memset(h->count, 0, sizeof(h->count));
+  for(sym = 0; sym < n; sym++)
+    h->count[lengths[sym]]++;
+  h->count[0] = 0;
+  for(len = 1; len < 16; len++)
+  {
+    left = 2*left - h->count[len];
+    if(left < 0)
+      return -1;
+  }
+  offs[1] = 0;
+  for(len = 1; len < 15; len++)
+    offs[len+1] = offs[len] + h->count[len];
+  for(len = 1; len < 16; len++)
+  {
+    code = (code + h->count[len-1]) << 1;
+    next[len] = code;
+  }
+  memset(h->fast, 0, sizeof(h->fast));
+  for(sym = 0; sym < n; sym++)
+  {
+    len = lengths[sym];
+    if(len == 0)
+      continue;
+    h->symbol[offs[len]++] = sym;
+    code = next[len]++;
+    if(len > SVFINFLATE_FAST)
+      continue;
+    // codes come first bit first: index by reversed code
+    uint32_t rev = 0;
+    for(uint32_t j = 0; j < len; j++)
+      rev |= ((code >> j) & 1) << (len-1-j);
+    for(; rev < (1u << SVFINFLATE_FAST); rev += 1u << len)
+      h->fast[rev] = sym << 4 | len;
+  }
+  return 0;
+}
+
+// symbol from the first bits of bb (bc bits valid), *used: its length
+// return value:
+// >= 0 - symbol
+// -1 - more bits needed
+// -2 - no such code
+static int32_t huff_decode(const struct S_svfhuff *h, uint64_t bb, uint32_t bc, uint32_t *used)
+{
+  uint16_t f = h->fast[bb & ((1 << SVFINFLATE_FAST) - 1)];
+  if(f != 0)
+  {
+    if((f & 15u) > bc)
+      return -1;
+    *used = f & 15;
+    return f >> 4;
+  }
+  // longer code: walk the lengths
+  int32_t code = 0, first = 0, index = 0;
+  for(uint32_t len = 1; len < 16; len++)
+  {
+    if(len > bc)
+      return -1;
+    code |= (bb >> (len-1)) & 1;
+    int32_t count = h->count[len];
+    if(code - first < count)
+    {
+      *used = len;
+      return h->symbol[index + code - first];
+    }
+    index += count;
+    first = (first + count) << 1;
+    code <<= 1;
+  }
+  return -2;
+}
+
+// pull packet bytes into the bit buffer, up to 64 bits
+static inline void fill(struct S_svfinflate *z)
+{
+  while(z->bitcnt <= 56 && z->in_left > 0)
+  {
+    z->bitbuf |= (uint64_t)*z->in++ << z->bitcnt;
+    z->bitcnt += 8;
+    z->in_left--;
+  }
+}
+
+static inline uint8_t need(struct S_svfinflate *z, uint32_t n)
+{
+  fill(z);
+  return z->bitcnt >= n;
+}
+
+static inline void drop(struct S_svfinflate *z, uint32_t n)
+{
+  z->bitbuf = n < 64 ? z->bitbuf >> n : 0;
+  z->bitcnt -= n;
+}
+
+// next header byte, -1 if the packet is used up
+static int32_t get_byte(struct S_svfinflate *z)
+{
+  if(!need(z, 8))
+    return -1;
+  uint8_t b = z->bitbuf;
+  drop(z, 8);
+  return b;
+}
+
+// window bytes not yet parsed go to the parser
+static void flush(struct S_svfinflate *z, uint8_t final)
+{
+  uint32_t n = z->wpos - z->flushed;
+  if(n == 0 && !final)
+    return;
+  z->crc = crc32_update(z->crc, z->window + z->flushed, n);
+  parse_svf_packet(z->svf, z->window + z->flushed, z->index, n, final);
+  z->index += n;
+  z->flushed = z->wpos;
+}
+
+// full window is parsed, then written again from its start
+static inline void wrap(struct S_svfinflate *z)
+{
+  if(z->wpos == SVFINFLATE_WINDOW)
+  {
+    flush(z, 0);
+    z->wpos = 0;
+    z->flushed = 0;
+  }
+}
+
+static inline void put(struct S_svfinflate *z, uint8_t b)
+{
+  z->window[z->wpos++] = b;
+  z->total++;
+  wrap(z);
+}
+
+// end of a deflate block, the last one finishes the parser
+static void block_end(struct S_svfinflate *z)
+{
+  if(!z->last)
+  {
+    z->state = ZS_BLOCK;
+    return;
+  }
+  flush(z, 1);
+  z->state = ZS_TRAILER;
+}
+
+static int8_t fixed_tables(struct S_svfinflate *z)
+{
+  uint32_t j;
+  for(j = 0; j < 144; j++)
+    z->lengths[j] = 8;
+  for(; j < 256; j++)
+    z->lengths[j] = 9;
+  for(; j < 280; j++)
+    z->lengths[j] = 7;
+  for(; j < 288; j++)
+    z->lengths[j] = 8;
+  for(j = 0; j < 30; j++)
+    z->lengths[288+j] = 5;
+  if(huff_build(&z->lit, z->lengths, 288) < 0 || huff_build(&z->dist, z->lengths + 288, 30) < 0)
+    return -1;
+  return 0;
+}
+
+// literals and matches until the end of block, the packet
+// is left as soon as a whole symbol is not in it
+static int8_t codes(struct S_svfinflate *z)
+{
+  for(;;)
+  {
+    fill(z);
+    uint64_t bb = z->bitbuf;
+    uint32_t bc = z->bitcnt, used;
+    int32_t sym = huff_decode(&z->lit, bb, bc, &used);
+    if(sym == -1)
+      return ZR_MORE;
+    if(sym < 0)
+      return ZR_ERROR;
+    bb >>= used;
+    bc -= used;
+    if(sym < 256)
+    {
+      drop(z, used);
+      put(z, sym);
+      continue;
+    }
+    if(sym == 256)
+    {
+      drop(z, used);
+      block_end(z);
+      return ZR_MORE;
+    }
+    sym -= 257;
+    if(sym >= 29)
+      return ZR_ERROR;
+    uint32_t e = Len_extra[sym];
+    if(bc < e)
+      return ZR_MORE;
+    uint32_t len = Len_base[sym] + (bb & ((1u << e) - 1));
+    bb >>= e;
+    bc -= e;
+    uint32_t dused;
+    int32_t dsym = huff_decode(&z->dist, bb, bc, &dused);
+    if(dsym == -1)
+      return ZR_MORE;
+    if(dsym < 0 || dsym >= 30)
+      return ZR_ERROR;
+    bb >>= dused;
+    bc -= dused;
+    e = Dist_extra[dsym];
+    if(bc < e)
+      return ZR_MORE;
+    uint32_t dist = Dist_base[dsym] + (bb & ((1u << e) - 1));
+    bc -= e;
+    if(dist > SVFINFLATE_WINDOW || dist > z->total)
+    {
+      PRINTF("inflate: distance %u beyond the window\n", dist);
+      return ZR_ERROR;
+    }
+    drop(z, z->bitcnt - bc); // whole match taken
+    uint32_t from = (z->wpos - dist) & (SVFINFLATE_WINDOW-1);
+    for(; len > 0; len--)
+    {
+      put(z, z->window[from]);
+      from = (from + 1) & (SVFINFLATE_WINDOW-1);
+    }
+  }
+}
+
+// decode as far as the packet goes
+static int8_t inflate(struct S_svfinflate *z)
+{
+  int32_t b;
+  for(;;)
+  {
+    switch(z->state)
+    {
+      case ZS_HEADER:
+        if((b = get_byte(z)) < 0)
+          return ZR_MORE;
+        if((z->count == 0 && b != 0x1F) || (z->count == 1 && b != 0x8B) || (z->count == 2 && b != 8))
+        {
+          PRINTF("inflate: not a gzip deflate stream\n");
+          return ZR_ERROR;
+        }
+        if(z->count == 3)
+          z->flags = b;
+        if(++z->count == 10)
+          z->state = ZS_XLEN;
+        break;
+      case ZS_XLEN:
+        if(!(z->flags & GZ_FEXTRA))
+        {
+          z->state = ZS_NAME;
+          break;
+        }
+        if(!need(z, 16))
+          return ZR_MORE;
+        z->count = z->bitbuf & 0xFFFF;
+        drop(z, 16);
+        z->state = ZS_EXTRA;
+        break;
+      case ZS_EXTRA:
+        for(; z->count > 0; z->count--)
+          if(get_byte(z) < 0)
+            return ZR_MORE;
+        z->state = ZS_NAME;
+        break;
+      case ZS_NAME:
+      case ZS_COMMENT:
+        if(z->flags & (z->state == ZS_NAME ? GZ_FNAME : GZ_FCOMMENT))
+          do
+          {
+            if((b = get_byte(z)) < 0)
+              return ZR_MORE;
+          }
+          while(b != 0);
+        z->state++;
+        break;
+      case ZS_HCRC:
+        if(z->flags & GZ_FHCRC)
+        {
+          if(!need(z, 16))
+            return ZR_MORE;
+          drop(z, 16);
+        }
+        z->state = ZS_BLOCK;
+        break;
+      case ZS_BLOCK:
+        if(!need(z, 3))
+          return ZR_MORE;
+        z->last = z->bitbuf & 1;
+        b = (z->bitbuf >> 1) & 3;
+        drop(z, 3);
+        if(b == 0)
+        {
+          drop(z, z->bitcnt & 7); // stored data starts at a byte
+          z->state = ZS_STORED_LEN;
+        }
+        else if(b == 1)
+        {
+          if(fixed_tables(z) < 0)
+            return ZR_ERROR;
+          z->state = ZS_CODES;
+        }
+        else if(b == 2)
+          z->state = ZS_TABLE_SIZES;
+        else
+          return ZR_ERROR;
+        break;
+      case ZS_STORED_LEN:
+        if(!need(z, 32))
+          return ZR_MORE;
+        if((z->bitbuf & 0xFFFF) != (~z->bitbuf >> 16 & 0xFFFF))
+          return ZR_ERROR;
+        z->count = z->bitbuf & 0xFFFF;
+        drop(z, 32);
+        z->state = ZS_STORED;
+        break;
+      case ZS_STORED:
+        // buffered bytes first, then straight from the packet
+        for(; z->count > 0 && z->bitcnt >= 8; z->count--)
+        {
+          put(z, z->bitbuf);
+          drop(z, 8);
+        }
+        while(z->count > 0 && z->in_left > 0)
+        {
+          uint32_t n = SVFINFLATE_WINDOW - z->wpos;
+          if(n > z->count)
+            n = z->count;
+          if(n > z->in_left)
+            n = z->in_left;
+          memcpy(z->window + z->wpos, z->in, n);
+          z->wpos += n;
+          z->total += n;
+          z->in += n;
+          z->in_left -= n;
+          z->count -= n;
+          wrap(z);
+        }
+        if(z->count > 0)
+          return ZR_MORE;
+        block_end(z);
+        break;
+      case ZS_TABLE_SIZES:
+        if(!need(z, 14))
+          return ZR_MORE;
+        z->hlit = 257 + (z->bitbuf & 31);
+        z->hdist = 1 + ((z->bitbuf >> 5) & 31);
+        z->hclen = 4 + ((z->bitbuf >> 10) & 15);
+        drop(z, 14);
+        if(z->hlit > 286 || z->hdist > 30)
+          return ZR_ERROR;
+        memset(z->lengths, 0, 19);
+        z->count = 0;
+        z->state = ZS_CLEN;
+        break;
+      case ZS_CLEN:
+        for(; z->count < z->hclen; z->count++)
+        {
+          if(!need(z, 3))
+            return ZR_MORE;
+          z->lengths[Clen_order[z->count]] = z->bitbuf & 7;
+          drop(z, 3);
+        }
+        if(huff_build(&z->codelen, z->lengths, 19) < 0)
+          return ZR_ERROR;
+        z->count = 0;
+        z->state = ZS_LENGTHS;
+        break;
+      case ZS_LENGTHS:
+        while(z->count < z->hlit + z->hdist)
+        {
+          // code length symbol with its repeat bits, all or nothing
+          fill(z);
+          uint64_t bb = z->bitbuf;
+          uint32_t bc = z->bitcnt, used, rep, e;
+          uint8_t len = 0;
+          int32_t sym = huff_decode(&z->codelen, bb, bc, &used);
+          if(sym == -1)
+            return ZR_MORE;
+          if(sym < 0)
+            return ZR_ERROR;
+          bb >>= used;
+          bc -= used;
+          if(sym < 16)
+          {
+            drop(z, used);
+            z->lengths[z->count++] = sym;
+            continue;
+          }
+          if(sym == 16)
+          {
+            if(z->count == 0)
+              return ZR_ERROR;
+            len = z->lengths[z->count-1];
+            e = 2;
+            rep = 3;
+          }
+          else if(sym == 17)
+          {
+            e = 3;
+            rep = 3;
+          }
+          else
+          {
+            e = 7;
+            rep = 11;
+          }
+          if(bc < e)
+            return ZR_MORE;
+          rep += bb & ((1u << e) - 1);
+          drop(z, used + e);
+          if(z->count + rep > z->hlit + z->hdist)
+            return ZR_ERROR;
+          for(; rep > 0; rep--)
+            z->lengths[z->count++] = len;
+        }
+        if(z->lengths[256] == 0 // no end of block code
+        || huff_build(&z->lit, z->lengths, z->hlit) < 0
+        || huff_build(&z->dist, z->lengths + z->hlit, z->hdist) < 0)
+          return ZR_ERROR;
+        z->state = ZS_CODES;
+        break;
+      case ZS_CODES:
+        b = codes(z);
+        if(b != ZR_MORE || z->state == ZS_CODES)
+          return b;
+        break;
+      case ZS_TRAILER:
+        // parser got all text at the end of the last block
+        drop(z, z->bitcnt & 7);
+        if(!need(z, 64))
+          return ZR_MORE;
+        if((uint32_t)z->bitbuf != z->crc || (uint32_t)(z->bitbuf >> 32) != (uint32_t)z->total)
+        {
+          PRINTF("inflate: CRC or length mismatch\n");
+          return ZR_ERROR;
+        }
+        drop(z, 64);
+        z->state = ZS_DONE;
+        return ZR_END;
+      default:
+        return z->state == ZS_DONE ? ZR_END : ZR_ERROR;
+    }
+  }
+}
+
+uint8_t svfinflate_detect(const uint8_t *data, uint32_t length)
+{
+  return length >= 2 && data[0] == 0x1F && data[1] == 0x8B;
+}
+
+int8_t svfinflate_init(struct S_svfinflate *z, struct S_svfparser *svf)
+{
+  memset(z, 0, sizeof(struct S_svfinflate));
+  z->svf = svf;
+  z->state = ZS_HEADER;
+  z->window = (uint8_t *)malloc(SVFINFLATE_WINDOW);
+  if(z->window == NULL)
+    return -1;
+  return 0;
+}
+
+int8_t svfinflate_packet(struct S_svfinflate *z, const uint8_t *packet, uint32_t length, uint8_t final)
+{
+  if(z->state == ZS_DONE)
+    return 1; // rest after the gzip member is ignored
+  if(z->state == ZS_ERROR)
+    return -1;
+  z->in = packet;
+  z->in_left = length;
+  int8_t r = inflate(z);
+  z->in = NULL;
+  z->in_left = 0;
+  if(r == ZR_END)
+    return 1;
+  if(r == ZR_MORE && !final)
+  {
+    flush(z, 0); // text so far is parsed while the next packet comes
+    return 0;
+  }
+  if(r == ZR_MORE)
+    PRINTF("inflate: stream truncated\n");
+  else
+    PRINTF("inflate: corrupt stream at text byte %llu\n", (unsigned long long)z->total);
+  if(z->state < ZS_TRAILER)
+    flush(z, 1); // parser is finished with the text it got
+  z->state = ZS_ERROR;
+  return -1;
+}
+
+void svfinflate_free(struct S_svfinflate *z)
+{
+  free(z->window);
+  memset(z, 0, sizeof(struct S_svfinflate));
+}
@@ -0,0 +1,76 @@
+#ifndef SVFINFLATE_H
+#define SVFINFLATE_H
+
+#include <stdint.h>
+#include "svfparser.h"
+
+/*
+streaming gzip (deflate, RFC 1951/1952) decoder in front
+of parse_svf_packet(): compressed packets of any size and
+split are given as they come, decompressed text goes to
+the parser whenever the window fills and at the end of
+each packet.
+
+the decoder suspends between any two symbols when the
+packet runs out, state is kept in S_svfinflate. memory is
+the window plus the code tables, nothing grows with the
+stream. deflate looks back up to 32 KB, a smaller window
+(embedded builds) only takes streams compressed with a
+window that small, longer distances are reported as error.
+*/
+
+// output window, power of 2, at most 32768
+#ifndef SVFINFLATE_WINDOW
+#define SVFINFLATE_WINDOW 32768
+#endif
+// bits of the first level code lookup
+#define SVFINFLATE_FAST 9
+
+// canonical Huffman code
+struct S_svfhuff
+{
+  uint16_t count[16]; // number of codes of each length
+  uint16_t symbol[288]; // symbols in code order
+  uint16_t fast[1 << SVFINFLATE_FAST]; // symbol<<4 | length of short codes, 0 if longer
+};
+
+struct S_svfinflate
+{
+  struct S_svfparser *svf; // receiver of the text
+  int8_t state;
+  uint8_t flags; // gzip header flags
+  uint8_t last; // last block
+  uint32_t count; // header bytes, code lengths or stored bytes to go
+  uint32_t hlit, hdist, hclen; // dynamic block table sizes
+  uint8_t lengths[288+32]; // code lengths being read
+  uint64_t bitbuf; // input bits not yet used, first in bit 0
+  uint32_t bitcnt;
+  const uint8_t *in; // rest of the current packet
+  uint32_t in_left;
+  uint8_t *window; // last SVFINFLATE_WINDOW bytes of text
+  uint32_t wpos; // next write position in window
+  uint32_t flushed; // window bytes up to here went to the parser
+  uint32_t index; // text bytes given to the parser
+  uint64_t total; // text bytes decoded
+  uint32_t crc; // CRC-32 of the text
+  struct S_svfhuff lit, dist, codelen;
+};
+
+// gzip magic at the start of data
+uint8_t svfinflate_detect(const uint8_t *data, uint32_t length);
+// initialize before the first packet, text goes to svf
+// return value:
+// 0 - ok
+// -1 - memory allocation failed
+int8_t svfinflate_init(struct S_svfinflate *z, struct S_svfparser *svf);
+// decompress a packet of the stream, final: no more packets.
+// the parser gets its final packet at the end of the gzip
+// member or of the input, whichever comes first
+// return value:
+// 0 - more packets expected
+// 1 - stream complete and its checksum correct
+// -1 - corrupt or truncated stream, parser was finished
+int8_t svfinflate_packet(struct S_svfinflate *z, const uint8_t *packet, uint32_t length, uint8_t final);
+void svfinflate_free(struct S_svfinflate *z);
+
+#endif
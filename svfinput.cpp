@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "svfparser.h"
+#include "svfinput.h"
+#include "svfinflate.h"
+
+#ifndef DBG_PRINT
+#define DBG_PRINT 1
+#endif
+#if DBG_PRINT
+#define PRINTF(f_, ...) printf((f_), ##__VA_ARGS__)
+#else
+#define PRINTF(f_, ...)
+#endif
+
+// packet to the decompressor or straight to the parser
+static int8_t svf_packet(struct S_svfparser *ctx, struct S_svfinflate *inflate, uint8_t gzip,
+  uint8_t *data, size_t index, size_t len, int final)
+{
+  if(gzip)
+    return svfinflate_packet(inflate, data, len, final) < 0 ? -1 : 0;
+  return parse_svf_packet(ctx, data, index, len, final);
+}
+
+// get chunk by chunk (simulate network) and call the parser,
+// gzip compressed file is detected from the first two bytes,
+// whatever the packet size, and decompressed on the way
+int svf_read_packets(struct S_svfparser *ctx, char *filename, size_t size)
+{
+  FILE *fp = fopen(filename, "rb");
+  if(fp == NULL)
+  {
+    printf("can't open %s\n", filename);
+    return -1;
+  }
+  uint8_t *packet_data = (uint8_t *) malloc(size * sizeof(uint8_t));
+  size_t packet_len;
+  size_t index = 0;
+  struct S_svfinflate inflate;
+  uint8_t start[2]; // first bytes, held until gzip is detected
+  size_t held = 0;
+  int8_t gzip = -1; // -1 not known yet
+  int result = 0;
+
+  while(!feof(fp))
+  {
+    packet_len = fread(packet_data, 1, size, fp);
+    PRINTF("packet len %ld\n", packet_len);
+    int final = packet_len < size ? 1 : 0;
+    uint8_t *data = packet_data;
+    size_t len = packet_len;
+    if(gzip < 0)
+    {
+      while(held < sizeof(start) && len > 0)
+      {
+        start[held++] = *data++;
+        len--;
+      }
+      if(held < sizeof(start) && !final)
+        continue;
+      gzip = svfinflate_detect(start, held);
+      if(gzip)
+      {
+        PRINTF("gzip compressed\n");
+        if(svfinflate_init(&inflate, ctx) < 0)
+        {
+          PRINTF("Memory Allocation Failed\n");
+          parse_svf_packet(ctx, NULL, 0, 0, 1); // parser gets its final packet
+          gzip = 0;
+          result = -1;
+          break;
+        }
+      }
+      // held bytes go first, final if nothing follows
+      if(svf_packet(ctx, &inflate, gzip, start, 0, held, final && len == 0) < 0)
+        result = -1;
+      index = held;
+      if(len == 0)
+        continue;
+    }
+    if(svf_packet(ctx, &inflate, gzip, data, index, len, final) < 0)
+      result = -1;
+    index += len;
+  }
+  PRINTF("total len %ld\n", index);
+  if(gzip > 0)
+  {
+    PRINTF("decompressed len %llu\n", (unsigned long long)inflate.total);
+    svfinflate_free(&inflate);
+  }
+  if(ctx->cmderr < 0)
+    result = -1; // text ended in a broken command
+  free(packet_data);
+  fclose(fp);
+  return result;
+}
+
+// zero copy: file is mapped read-only and parsed as
+// one packet, kernel reads ahead sequentially
+int svf_read_mmap(struct S_svfparser *ctx, char *filename)
+{
+  struct stat st;
+  int fd = open(filename, O_RDONLY);
+  if(fd < 0)
+  {
+    printf("can't open %s\n", filename);
+    return -1;
+  }
+  if(fstat(fd, &st) < 0 || (uint64_t)st.st_size > 0xFFFFFFFF)
+  {
+    printf("can't map %s\n", filename);
+    close(fd);
+    return -1;
+  }
+  if(st.st_size == 0)
+  {
+    close(fd);
+    return parse_svf_packet(ctx, NULL, 0, 0, 1);
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED)
+  {
+    printf("can't map %s\n", filename);
+    return -1;
+  }
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+  int result = 0;
+  if(svfinflate_detect((uint8_t *)map, st.st_size))
+  {
+    // compressed: text goes through the window, not in place
+    struct S_svfinflate inflate;
+    if(svfinflate_init(&inflate, ctx) < 0)
+    {
+      PRINTF("Memory Allocation Failed\n");
+      parse_svf_packet(ctx, NULL, 0, 0, 1); // parser gets its final packet
+      result = -1;
+    }
+    else if(svfinflate_packet(&inflate, (uint8_t *)map, st.st_size, 1) < 0 || ctx->cmderr < 0)
+      result = -1;
+    svfinflate_free(&inflate);
+  }
+  else if(parse_svf_packet(ctx, (uint8_t *)map, 0, st.st_size, 1) < 0)
+    result = -1;
+  PRINTF("total len %ld\n", (long)st.st_size);
+  munmap(map, st.st_size);
+  return result;
+}
@@ -0,0 +1,16 @@
+#ifndef SVFINPUT_H
+#define SVFINPUT_H
+
+#include <stddef.h>
+#include "svfparser.h"
+
+// default packet size, fits one ethernet frame
+#define SVF_PACKET_SIZE 1436
+
+// get chunk by chunk (simulate network) and call the parser
+int svf_read_packets(struct S_svfparser *ctx, char *filename, size_t size);
+
+// map whole file and parse it in place with one call
+int svf_read_mmap(struct S_svfparser *ctx, char *filename);
+
+#endif
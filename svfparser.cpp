@@ -1,25 +1,94 @@
 #include <stdint.h>
 #include "svfparser.h"
+#include "svfhex.h"
+#include "svfpipe.h"
+#include "svfcache.h"
+#include "svfscan.h"
 #include "jtaghw_print.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h> // toupper()
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
+#ifndef DBG_PRINT
 #define DBG_PRINT 1
+#endif
 #if DBG_PRINT
 #define PRINTF(f_, ...) printf((f_), ##__VA_ARGS__)
 #else
 #define PRINTF(f_, ...)
 #endif
 
+// binary trace of parser events (svftrace.h)
+#if SVF_TRACE
+// event of the command being parsed
+#define TRACE(ctx, id, small, a, b) svftrace_put(&(ctx)->trace, id, (ctx)->commands + 1, small, a, b)
+// event of the command being played, already counted
+#define TRACE_PLAY(ctx, id, small, a, b) svftrace_put(&(ctx)->trace, id, (ctx)->commands, small, a, b)
+#else
+#define TRACE(ctx, id, small, a, b)
+#define TRACE_PLAY(ctx, id, small, a, b)
+#endif
+
+// stage timing for svfbench, each switch reads the clock once
+#ifndef SVF_PROFILE
+#define SVF_PROFILE 0
+#endif
+#if SVF_PROFILE
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static inline uint64_t profile_ticks()
+{
+  #if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+  #else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+  #endif
+}
+
+// time since the last switch goes to the stage being
+// timed, then stage is timed. return value: stage before
+static inline uint8_t profile_switch(struct S_svfparser *ctx, uint8_t stage)
+{
+  struct S_svfprofile *p = &ctx->profile;
+  uint64_t t = profile_ticks();
+  uint8_t prev = p->stage;
+  p->ticks[prev] += t - p->since;
+  p->since = t;
+  p->stage = stage;
+  return prev;
+}
+
+#define PROFILE_START(ctx) ((ctx)->profile.since = profile_ticks(), (ctx)->profile.stage = STAGE_LEXER)
+#define PROFILE_STOP(ctx) profile_switch(ctx, STAGE_LEXER)
+#define PROFILE_ENTER(ctx, stage) uint8_t profile_prev = profile_switch(ctx, stage)
+#define PROFILE_LEAVE(ctx) profile_switch(ctx, profile_prev)
+#define PROFILE_BYTES(ctx, stage, n) ((ctx)->profile.bytes[stage] += (n))
+#else
+#define PROFILE_START(ctx)
+#define PROFILE_STOP(ctx)
+#define PROFILE_ENTER(ctx, stage)
+#define PROFILE_LEAVE(ctx)
+#define PROFILE_BYTES(ctx, stage, n)
+#endif
+
 
 /*
 [SVF Format spec](http://www.jtagtest.com/pdf/svf_specification.pdf)
 [TI test symposium](http://home.zcu.cz/~dudacek/Kp/seminar2.pdf)
 */
 
-// max bytes allowed to allocate per bitfield
+// bitfields are stored as chains of SVF_CHUNK_BYTES chunks,
+// so a several MB SDR needs no big contiguous block and
+// growing it copies only the chunk pointers.
 // HDR,HIR,TDR,TIR each may need 0-4 bitfields
 // SDR,SIR by the standard should be remembered
 // the same way as HDR is rememberd but here we
@@ -30,11 +99,9 @@
 
 // immediately, buffer can be alloced at invocation of
 // TDI, even shorter than neccessary. In this buffer
-// TDO response is stored until the buffer is full
-// and excess data discarded with warning message.
+// TDO response is stored.
 // Response (even partial) can be optionally used later
 // for masking and verification
-const int MAX_alloc = 30000;
 
 // lowest level lexical parser states
 // to eliminate comments and whitespaces
@@ -54,27 +121,7 @@ enum
  TS_BRACKET,
 };
 
-// enumerated (tokenized) reserved words
-enum 
-{
-  CMD_ENDDR=0, // Specifies default end state for DR scan operations.
-  CMD_ENDIR, // Specifies default end state for IR scan operations.
-  CMD_FREQUENCY, // Specifies maximum test clock frequency for IEEE 1149.1 bus operations.
-  CMD_HDR, // (Header Data Register) Specifies a header pattern that is prepended to the beginning of subsequent DR scan operations.
-  CMD_HIR, // (Header Instruction Register) Specifies a header pattern that is prepended to the beginning of subsequent IR scan operations.
-  CMD_PIO, // (Parallel Input/Output) Specifies a parallel test pattern.
-  CMD_PIOMAP, // (Parallel Input/Output Map) Maps PIO column positions to a logical pin.
-  CMD_RUNTEST, // Forces the IEEE 1149.1 bus to a run state for a specified number of clocks or a specified time period.
-  CMD_SDR, // (Scan Data Register) Performs an IEEE 1149.1 Data Register scan.
-  CMD_SIR, // (Scan Instruction Register) Performs an IEEE 1149.1 Instruction Register scan.
-  CMD_STATE, // Forces the IEEE 1149.1 bus to a specified stable state.
-  CMD_TDR, // (Trailer Data Register) Specifies a trailer pattern that is appended to the end of subsequent DR scan operations.
-  CMD_TIR, // (Trailer Instruction Register) Specifies a trailer pattern that is appended to the end of subsequent IR scan operations.
-  CMD_TRST, // (Test ReSeT) Controls the optional Test Reset line.
-  CMD_NUM // LAST: represents number of reserved words
-};
-
-const char *Commands[] =
+constexpr const char *const Svf_command_name[CMD_NUM+1] =
 {
   [CMD_ENDDR] = "ENDDR",
   [CMD_ENDIR] = "ENDIR",
@@ -93,12 +140,9 @@ const char *Commands[] =
   [CMD_NUM] = NULL
 };
 
-int Completed_command = CMD_NUM; // completed command
-
-// quick search: first 4 chars of command are enough 
+// quick search: first 4 chars of command are enough
+// (together with the last char and the length)
 #define CMDS_ENOUGH_CHARS 4
-// maximal command length (buffering)
-#define CMDS_MAX_CHARS 15
 
 // find which command matches it and track the rest of it
 // to eventually report unknown/unsupported command
@@ -110,34 +154,7 @@ enum cmd_detection_states
   CD_ERROR, // command not found or not matching (syntax error)
 };
 
-// TAP states enumerated/tokenized
-enum libxsvf_tap_state 
-{
-  /* Special States */
-  LIBXSVF_TAP_INIT = 0,
-  LIBXSVF_TAP_RESET = 1,
-  LIBXSVF_TAP_IDLE = 2,
-  /* DR States */
-  LIBXSVF_TAP_DRSELECT = 3,
-  LIBXSVF_TAP_DRCAPTURE = 4,
-  LIBXSVF_TAP_DRSHIFT = 5,
-  LIBXSVF_TAP_DREXIT1 = 6,
-  LIBXSVF_TAP_DRPAUSE = 7,
-  LIBXSVF_TAP_DREXIT2 = 8,
-  LIBXSVF_TAP_DRUPDATE = 9,
-  /* IR States */
-  LIBXSVF_TAP_IRSELECT = 10,
-  LIBXSVF_TAP_IRCAPTURE = 11,
-  LIBXSVF_TAP_IRSHIFT = 12,
-  LIBXSVF_TAP_IREXIT1 = 13,
-  LIBXSVF_TAP_IRPAUSE = 14,
-  LIBXSVF_TAP_IREXIT2 = 15,
-  LIBXSVF_TAP_IRUPDATE = 16,
-  /* numbef of them */
-  LIBXSVF_TAP_NUM = 17,
-};
-
-const char *Tap_states[] =
+constexpr const char *const Svf_tap_state_name[LIBXSVF_TAP_NUM+1] =
 {
   [LIBXSVF_TAP_INIT] = "INIT",
   [LIBXSVF_TAP_RESET] = "RESET",
@@ -159,12 +176,6 @@ const char *Tap_states[] =
   [LIBXSVF_TAP_NUM] = NULL
 };
 
-// endstate name DRCAPTURE is longest: 9 chars
-enum libxsvf_tap_name_max_len
-{
-  LIBXSVF_TAP_NAME_MAXLEN = 9
-};
-
 // common states for HDR,HIR,SDR,SIR,TDR,TIR
 enum bit_sequence_parsing_states
 {
@@ -178,16 +189,7 @@ enum bit_sequence_parsing_states
   BSPS_ERROR
 };
 
-enum bit_sequence_field
-{
-  BSF_TDO = 0,
-  BSF_TDI,
-  BSF_MASK,
-  BSF_SMASK,
-  BSF_NUM
-};
-
-const char *bsf_name[] =
+constexpr const char *const Svf_field_name[BSF_NUM+1] =
 {
   [BSF_TDO] = "TDO",
   [BSF_TDI] = "TDI",
@@ -224,27 +226,13 @@ static int state_endrun = LIBXSVF_TAP_IDLE;
 #endif
 
 uint8_t PAD_BYTE[2] = {0x00, 0xFF};
-uint8_t ReverseNibble[16];
-
-// bit sequence struct common for
-// HDR,HIR,SDR,SIR,TDR,TIR
-struct S_bitseq
+// nibble bit order as stored in bitfields when msb_first
+const uint8_t ReverseNibble[16] =
 {
-  uint32_t length;
-  uint32_t length_prev[BSF_NUM]; // lengths of each bitfield of previous SVF command
-  int32_t digitindex[BSF_NUM]; // insertion digit (nibble) index running from 2*allocated-1 downto 0. -1 if no space left.
-  uint32_t allocated[BSF_NUM]; // how many bytes are allocated in field[]
-  uint8_t *field[BSF_NUM]; // *tdo, *tdi, *mask, *smask;
+  0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE,
+  0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF
 };
 
-struct S_float
-{
-  int number, frac, expsign, exponent;
-  int8_t state;
-};
-
-struct S_float fl;
-
 
 /* memory storage plan
 
@@ -310,28 +298,10 @@ output data
 // initialize all as NULL pointers (unallocated space)
 // reallocating them as needed
 // 1 for direct I/O (no allocation, no buffering)
-struct S_bitseq BS_hdr = { 0, {0,0,0,0}, {-1,-1,-1,-1}, {0,0,0,0}, {NULL, NULL, NULL, NULL} };
-struct S_bitseq BS_hir = { 0, {0,0,0,0}, {-1,-1,-1,-1}, {0,0,0,0}, {NULL, NULL, NULL, NULL} };
-struct S_bitseq BS_sdr = { 0, {0,0,0,0}, {-1,-1,-1,-1}, {0,0,0,0}, {NULL, NULL, NULL, NULL} };
-struct S_bitseq BS_sir = { 0, {0,0,0,0}, {-1,-1,-1,-1}, {0,0,0,0}, {NULL, NULL, NULL, NULL} };
-struct S_bitseq BS_tdr = { 0, {0,0,0,0}, {-1,-1,-1,-1}, {0,0,0,0}, {NULL, NULL, NULL, NULL} };
-struct S_bitseq BS_tir = { 0, {0,0,0,0}, {-1,-1,-1,-1}, {0,0,0,0}, {NULL, NULL, NULL, NULL} };
 
-// bitfield name "SMASK" is longest: 5 chars
-enum bitfield_name_max_len
-{
-  BF_NAME_MAXLEN = 5
-};
 
 /* ************ end state parsing *************** */
 
-enum endxr_state_choice
-{
-  ENDX_ENDDR = 0,
-  ENDX_ENDIR,
-  ENDX_NUM
-};
-
 enum endxr_parsing_state
 {
   ENPS_INIT = 0,
@@ -340,14 +310,6 @@ enum endxr_parsing_state
   ENPS_ERROR
 };
 
-uint8_t endxr_state[ENDX_NUM] = { LIBXSVF_TAP_IDLE, LIBXSVF_TAP_IDLE };
-
-// endstate name IRPAUSE is longest: 7 chars
-enum end_name_max_len
-{
-  END_NAME_MAXLEN = 7
-};
-
 /* ************ state path parsing *************** */
 enum state_walk_parsing_state
 {
@@ -358,6 +320,7 @@ enum state_walk_parsing_state
   SWPS_ERROR
 };
 
+
 /* ************ runtest parsing *************** */
 enum runtest_parsing_state
 {
@@ -388,7 +351,7 @@ enum runtest_words_token
   RT_WORD_NUM
 };
 
-const char *runtest_words[] =
+constexpr const char *runtest_words[] =
 {
   [RT_WORD_TCK] = "TCK",
   [RT_WORD_SCK] = "SCK",
@@ -398,298 +361,627 @@ const char *runtest_words[] =
   [RT_WORD_NUM] = NULL
 };
 
-// max name length for all runtest names
-enum runtest_name_max_len
-{
-  RUNTEST_NAME_MAXLEN = 9
-};
 
-struct S_jtaghw JTAG_TDI, JTAG_TDO;
 
 
 /* ***************** bit sequence output ********************** */
-void play_bitsequence(struct S_bitseq *seq)
-{
-  // print what would be bitbanged
-  // if byte incomplete, print first 4 data bits
-  // print complete data bytes
-  // print last 0-7 data bits and trailing 0-bits
-  // print trailing 0-bytes
-  int i, j, k;
-  // PRINTF("length %d bit\n", seq->length);
-  int tdo_digitlen = (seq->length+3)/4-1 - seq->digitindex[BSF_TDO];
-  for(i = 0; i < BSF_NUM; i++)
+
+// pointer to byte b of bitfield i
+static inline uint8_t *bitseq_byte(struct S_bitseq *seq, int i, uint32_t b)
+{
+  return seq->field[i][b / SVF_CHUNK_BYTES] + b % SVF_CHUNK_BYTES;
+}
+
+// make room for bytes in bitfield i, chunks are kept
+// for the next command when the field shrinks.
+// one spare byte past the end is always there
+// return value:
+// 0 - ok
+// -1 - memory allocation failed
+static int8_t bitseq_alloc(struct S_svfparser *ctx, struct S_bitseq *seq, int i, uint32_t bytes)
+{
+  uint32_t chunks = bytes / SVF_CHUNK_BYTES + 1;
+  if(chunks > seq->chunks[i])
   {
-    if(seq->allocated[i] == 0 || seq->field[i] == NULL)
-      continue; // not allocated
-
-    // PRINTF("seq->length = %d, seq->digitindex = %d\n", seq->length, seq->digitindex[i]);
-    // from seq->length and seq->digitindex we calculate following:
-
-    //int max_full_digits = seq->length/4;
-    int digitlen = (seq->length+3)/4-1 - seq->digitindex[i];
-    int bytelen = (digitlen+1)/2;
-    int bits_remaining = seq->length - 8 * bytelen;
-    int firstbyte = (seq->digitindex[i]+1)/2;
-    uint8_t *mem = seq->field[i] + firstbyte;
-    // int complete_bytes = bits_remaining < 0 ? bytelen - 1 : bytelen;
-    int complete_bytes = bits_remaining < 0 ? bytelen - 1 : bytelen;
-    uint8_t pad_byte = i == BSF_MASK || i == BSF_SMASK ? 0xFF : 0x00;
-    int print_first_nibble = bits_remaining >= 0 ?
-        ((bits_remaining & 7) >= 1 && (bits_remaining & 7) <= 4)  // when padding bits
-      : ( -bits_remaining >= 1 && -bits_remaining <= 3); // when truncating bits
-    print_first_nibble = ((seq->length+3)/4 + 2*bytelen + digitlen) & 1;
-    // print_first_nibble = print_first_nibble ? 1 : 0;
-    // correction to the bits remaining
-    // bits_remaining = seq->length - 8 * bytelen + 4 * print_first_nibble;
-    
-    // initialize (reset) bitbang pointers
-    JTAG_TDI.header = NULL;
-    JTAG_TDI.header_bits = 0;
-    JTAG_TDI.data = NULL;
-    JTAG_TDI.data_bytes = 0;
-    JTAG_TDI.trailer = NULL;
-    JTAG_TDI.trailer_bits = 0;
-    JTAG_TDI.pad = pad_byte; // 0 or 0xFF padding value
-    JTAG_TDI.pad_bits = 0; // number of padding bits (not 0 if exist)
-
-    #if 9
-    PRINTF("bytelen=%d\n", bytelen);
-    PRINTF("complete bytes=%d\n", complete_bytes);
-    PRINTF("bits_remaining=%d\n", bits_remaining);
-    int memlen = seq->allocated[i] - firstbyte;
-    PRINTF("memlen=%d\n", memlen);
-    #if REVERSE_NIBBLE
-    for(j = 0; j < memlen; j++)
-      PRINTF("%01X%01X ", ReverseNibble[mem[j] >> 4], ReverseNibble[mem[j] & 0xF]);
-    #else
-    for(j = 0; j < memlen; j++)
-      PRINTF("%02X ", mem[j]);
-    #endif
-    PRINTF("\n");
-    PRINTF("reading from %d\n", firstbyte);
-    PRINTF("print first nibble %d\n", print_first_nibble);
-    PRINTF("field %s (%d digits)\n", bsf_name[i], digitlen);
-    #endif
-    PRINTF("%5s ", bsf_name[i]);
-    if( (digitlen > 0 && i != BSF_MASK)
-    ||  (digitlen > 0 && i == BSF_MASK && tdo_digitlen > 0)
-    )
+    uint8_t **field = (uint8_t **)realloc(seq->field[i], chunks * sizeof(uint8_t *));
+    if(field == NULL)
+      return -1;
+    seq->field[i] = field;
+    ctx->stats.reallocs++;
+    for(; seq->chunks[i] < chunks; seq->chunks[i]++)
     {
-      int total_bits_remaining = seq->length;
-      //PRINTF("total remain %d ", total_bits_remaining);
-      if(print_first_nibble)
-      {
-        // nibble
-        #if REVERSE_NIBBLE
-        PRINTF("0x%01X ", ReverseNibble[mem[0] & 0xF]);
-        #else
-        PRINTF("0x%01X ", mem[0] >> 4);
-        #endif
-        // print_first_nibble = 1;
-        JTAG_TDI.header = mem;
-        JTAG_TDI.header_bits = 4;
-        total_bits_remaining -= 4;
-      }
-      if(complete_bytes > 0)
-      {
-        PRINTF("0x");
-        for(j = print_first_nibble; j < complete_bytes; j++)
-        {
-          #if REVERSE_NIBBLE
-          PRINTF("%01X%01X", ReverseNibble[mem[j] >> 4], ReverseNibble[mem[j] & 0xF]);
-          #else
-          PRINTF("%01X%01X", mem[j] & 0xF, mem[j] >> 4);
-          #endif
-          total_bits_remaining -= 8;
-        }
-        PRINTF(" ");
-        JTAG_TDI.data = mem + print_first_nibble;
-        JTAG_TDI.data_bytes = complete_bytes-print_first_nibble;
-      }
-      uint8_t b_remaining = (8+bits_remaining) & 7;
-      //PRINTF("total remain %d b_rem %d ", total_bits_remaining, b_remaining);
-      if(print_first_nibble != 0)
-      {
-        if(total_bits_remaining >= 4 && b_remaining >= 4)
-        {
-          // full nibble
-          #if REVERSE_NIBBLE
-          PRINTF("0x%01X ", ReverseNibble[mem[j] >> 4]);
-          #else
-          PRINTF("0x%01X ", mem[j] & 0xF);
-          #endif
-          total_bits_remaining -= 4;
-        }
-        if(total_bits_remaining > 0 && bits_remaining < 0 && b_remaining >= 0)
-        {
-          uint8_t byte_partial = mem[j];
-          #if REVERSE_NIBBLE
-          #else
-            PRINTF("0b");
-            for(k = 0; k < b_remaining && total_bits_remaining > 0; k++, byte_partial >>= 1, total_bits_remaining--)
-              PRINTF("%d", byte_partial & 1);
-            PRINTF(" ");
-          #endif
-        }
-        // patch upper nibble of mem[j] with the nibble from pad_byte
-        mem[j] |= pad_byte & 0xF0;
-        JTAG_TDI.trailer = mem + j;
-        JTAG_TDI.trailer_bits = 4;
-      }
-      else
-      {
-        if(total_bits_remaining >= 4 && bits_remaining < 0 && -bits_remaining <= 4)
-        {
-          // full nibble
-          #if REVERSE_NIBBLE
-          PRINTF("0x%01X ", ReverseNibble[mem[j] >> 4]);
-          #else
-          PRINTF("0x%01X ", mem[j] & 0xF);
-          #endif
-          total_bits_remaining -= 4;
-        }
-        if(total_bits_remaining > 0 && bits_remaining < 0 && b_remaining > 0)
-        {
-          #if REVERSE_NIBBLE
-          #else
-            uint8_t byte_partial = mem[j] >> 4;
-            PRINTF("0b");
-            for(k = 0; k < b_remaining && total_bits_remaining > 0; k++, byte_partial >>= 1, total_bits_remaining--)
-              PRINTF("%d", byte_partial & 1);
-            PRINTF(" ");
-          #endif
-        }
-        // patch upper nibble of mem[j] with the nibble from pad_byte
-        mem[j] |= pad_byte & 0xF0;
-        JTAG_TDI.trailer = mem + j;
-        JTAG_TDI.trailer_bits = 4;
-      }
-      // **************** completed from data, now padding *****************
-      PRINTF("total remain %d ", total_bits_remaining);
-      #if 0
-      if(bits_remaining != 0)
+      field[seq->chunks[i]] = svfarena_get(&ctx->arena);
+      if(field[seq->chunks[i]] == NULL)
+        return -1;
+    }
+  }
+  seq->allocated[i] = bytes;
+  return 0;
+}
+
+// release all chunks of bitfield i to the pool
+static void bitseq_release(struct S_svfparser *ctx, struct S_bitseq *seq, int i)
+{
+  for(uint32_t c = 0; c < seq->chunks[i]; c++)
+    svfarena_put(&ctx->arena, seq->field[i][c]);
+  free(seq->field[i]);
+  seq->field[i] = NULL;
+  seq->chunks[i] = 0;
+  seq->allocated[i] = 0;
+}
+
+// number of hex digits given for the field
+// 0 or less if field has no value
+int32_t bitseq_digits(struct S_bitseq *seq, int i)
+{
+  if(seq->allocated[i] == 0 || seq->field[i] == NULL)
+    return 0;
+  return (seq->length+3)/4-1 - seq->digitindex[i];
+}
+
+// hex digit stored at insertion index
+template<uint8_t Msb>
+static inline uint8_t bitseq_digit(struct S_bitseq *seq, int i, int32_t index)
+{
+  uint8_t byte = *bitseq_byte(seq, i, index/2);
+  if(Msb)
+    return ReverseNibble[(index & 1) != 0 ? byte & 0xF : byte >> 4];
+  return (index & 1) != 0 ? byte >> 4 : byte & 0xF;
+}
+
+// pack bitfield in shift order into (length+7)/8 bytes at dst.
+// digits not given are filled from pad_byte,
+// bits above the length are cleared
+template<uint8_t Msb>
+static void bitseq_pack_t(struct S_bitseq *seq, int i, uint8_t pad_byte, uint8_t *dst)
+{
+  uint32_t bytes = (seq->length+7)/8;
+  int32_t digits = bitseq_digits(seq, i);
+  int32_t first = seq->digitindex[i]+1; // insertion index of the least significant digit
+  int32_t d = 0;
+  memset(dst, pad_byte, bytes);
+  if(digits > 0 && (first & 1) == 0)
+  {
+    // nibbles are byte aligned, copy complete bytes
+    for(uint32_t b = 0; b < (uint32_t)digits/2; )
+    {
+      uint32_t run = SVF_CHUNK_BYTES - (first/2 + b) % SVF_CHUNK_BYTES;
+      if(run > digits/2 - b)
+        run = digits/2 - b;
+      memcpy(dst + b, bitseq_byte(seq, i, first/2 + b), run);
+      b += run;
+    }
+    d = digits & ~1;
+  }
+  for(; d < digits; d++)
+  {
+    uint8_t hexdigit = bitseq_digit<Msb>(seq, i, first + d);
+    uint8_t shift = ((d & 1) != 0) != Msb ? 4 : 0;
+    if(Msb)
+      hexdigit = ReverseNibble[hexdigit];
+    dst[d/2] = (dst[d/2] & ~(0xF << shift)) | (hexdigit << shift);
+  }
+  if((seq->length & 7) != 0)
+  {
+    if(Msb)
+      dst[bytes-1] &= 0xFF << (8 - (seq->length & 7));
+    else
+      dst[bytes-1] &= 0xFF >> (8 - (seq->length & 7));
+  }
+}
+
+void bitseq_pack(struct S_bitseq *seq, int i, uint8_t pad_byte, uint8_t *dst, uint8_t msb_first)
+{
+  if(msb_first)
+    bitseq_pack_t<1>(seq, i, pad_byte, dst);
+  else
+    bitseq_pack_t<0>(seq, i, pad_byte, dst);
+}
+
+// pack field i of the header (HDR/HIR) or trailer (TDR/TIR)
+// command at bit position at. TDO not given there is don't care:
+// masked out when the scan is compared
+static void bitseq_pack_at(struct S_bitseq *seq, int i, uint8_t *dst, uint32_t at, uint8_t *tmp, uint8_t msb_first)
+{
+  uint8_t given_tdo = bitseq_digits(seq, BSF_TDO) > 0;
+  if(seq->length == 0)
+    return;
+  if(i == BSF_MASK && !given_tdo)
+    memset(tmp, 0x00, (seq->length+7)/8);
+  else
+    bitseq_pack(seq, i, i == BSF_MASK ? 0xFF : 0x00, tmp, msb_first);
+  svfscan_bits_merge(dst, at, tmp, seq->length, msb_first);
+}
+
+// pack scan in shift order: header command (HIR/HDR), scan,
+// trailer command (TIR/TDR) into ctx->pack. TDI at pack[0],
+// TDO at pack[bytes], MASK at pack[2*bytes] if TDO is given,
+// tdi = 0 packs only TDO and MASK
+// return value:
+// >= 0 - length in bits
+// -1 - memory allocation failed
+static int64_t scan_pack(struct S_svfparser *ctx, struct S_bitseq *head, struct S_bitseq *seq,
+  struct S_bitseq *tail, uint8_t tdi)
+{
+  // header and trailer commands are merged at bit level,
+  // one more area is needed to pack them
+  uint8_t merge = head->length > 0 || tail->length > 0;
+  uint8_t tdo = bitseq_digits(seq, BSF_TDO) > 0;
+  uint32_t length = head->length + seq->length + tail->length;
+  uint32_t bytes = (length+7)/8;
+  uint32_t need = (merge ? 4 : 3) * bytes;
+  if(need > ctx->pack_allocated)
+  {
+    uint8_t *pack = (uint8_t *)realloc(ctx->pack, need);
+    if(pack == NULL)
+    {
+      TRACE_PLAY(ctx, TR_ALLOC, 0, need, 0);
+      PRINTF("Memory Allocation Failed\n");
+      return -1;
+    }
+    ctx->pack = pack;
+    ctx->pack_allocated = need;
+    ctx->stats.reallocs++;
+  }
+  uint8_t *tmp = ctx->pack + 3*bytes;
+  if(!merge)
+  {
+    if(tdi)
+      bitseq_pack(seq, BSF_TDI, 0x00, ctx->pack, ctx->msb_first);
+    if(tdo)
+    {
+      bitseq_pack(seq, BSF_TDO, 0x00, ctx->pack + bytes, ctx->msb_first);
+      bitseq_pack(seq, BSF_MASK, 0xFF, ctx->pack + 2*bytes, ctx->msb_first);
+    }
+    return length;
+  }
+  // header bits are shifted first
+  memset(ctx->pack, 0, 3*bytes);
+  for(int i = BSF_TDO; i <= BSF_MASK; i++)
+  {
+    if(i == BSF_TDI ? !tdi : !tdo)
+      continue;
+    uint8_t *dst = ctx->pack + (i == BSF_TDI ? 0 : i == BSF_TDO ? bytes : 2*bytes);
+    bitseq_pack_at(head, i, dst, 0, tmp, ctx->msb_first);
+    bitseq_pack(seq, i, i == BSF_MASK ? 0xFF : 0x00, tmp, ctx->msb_first);
+    svfscan_bits_merge(dst, head->length, tmp, seq->length, ctx->msb_first);
+    bitseq_pack_at(tail, i, dst, head->length + seq->length, tmp, ctx->msb_first);
+  }
+  return length;
+}
+
+// pass completed command to the sink instead of bitbanging
+void sink_command(struct S_svfparser *ctx)
+{
+  uint8_t ir, endstate;
+  int64_t length;
+  switch(ctx->completed_command)
+  {
+    case CMD_SIR:
+    case CMD_SDR:
+      ir = ctx->completed_command == CMD_SIR;
+      endstate = ctx->endxr_state[ir ? ENDX_ENDIR : ENDX_ENDDR];
+      if(ctx->sink->scan == NULL)
+        break;
+      length = ir ? scan_pack(ctx, &ctx->bs_hir, &ctx->bs_sir, &ctx->bs_tir, 1)
+                  : scan_pack(ctx, &ctx->bs_hdr, &ctx->bs_sdr, &ctx->bs_tdr, 1);
+      if(length >= 0)
       {
-        uint8_t byte_remaining = pad_byte;
-        uint8_t additional_bits = (8+bits_remaining) & 7;
-        if(print_first_nibble != 0 && additional_bits > 4)
-          additional_bits -= 4;
-        uint8_t additional_bytes = bits_remaining / 8;
-        if(bits_remaining < 0)
-          byte_remaining = mem[j];
-        JTAG_TDI.pad_bits = additional_bits + additional_bytes * 8;
-        if(additional_bits > 0)
-        {
-          if(JTAG_TDI.trailer_bits == 0)
-          {
-            // change lower bits to bits from pad byte.
-            // bits in mem[] are reordered
-            // for transmission therefore we have
-            // small bitwise gymnastics:
-            if(bits_remaining < 0)
-            {
-              #if REVERSE_NIBBLE
-              uint8_t mask_byte = 0xFF >> (8-additional_bits); // mask for lower bits
-              uint8_t and_byte = (ReverseNibble[mask_byte >> 4])
-                               | (ReverseNibble[mask_byte & 0xF] << 4);
-
-              #else
-              uint32_t mask_byte = ((uint32_t)0xFF) << (additional_bits); // mask for lower bits
-              // mask_byte = 0xFF; // FIXME
-              uint8_t and_byte = mask_byte;
-              #endif
-              mem[j] |= pad_byte & and_byte;
-              JTAG_TDI.trailer = mem + j;
-              JTAG_TDI.trailer_bits = additional_bits;
-              JTAG_TDI.pad_bits = additional_bytes * 8;
-            }
-            else
-            {
-              JTAG_TDI.pad_bits = additional_bits + additional_bytes * 8;
-            }
-          }
-          if(additional_bits >= 4)
-          {
-            // byte_remaining = mem[j];
-            #if REVERSE_NIBBLE
-              PRINTF("0x%01X ", ReverseNibble[byte_remaining >> 4]);
-              if(additional_bits > 4)
-              {
-                PRINTF("0b");
-                byte_remaining <<= 4;
-                for(j = 4; j < additional_bits; j++, byte_remaining <<= 1)
-                  PRINTF("%d", byte_remaining >> 7);
-                PRINTF(" ");
-              }
-            #else
-              PRINTF("0x%01X ", byte_remaining & 0xF);
-              if(additional_bits > 4)
-              {
-                PRINTF("0b");
-                byte_remaining >>= 4;
-                for(j = 4; j < additional_bits; j++, byte_remaining >>= 1)
-                  PRINTF("%d", byte_remaining & 1);
-                PRINTF(" ");
-              }
-            #endif
-          }
-          else
-          {
-            PRINTF("*0b");
-            #if REVERSE_NIBBLE
-            for(j = 0; j < additional_bits; j++, byte_remaining <<= 1)
-              PRINTF("%d", byte_remaining >> 7);
-            #else
-            // PRINTF("(%02X)", byte_remaining);
-            for(j = 0; j < additional_bits; j++, byte_remaining >>= 1)
-              PRINTF("%d", byte_remaining & 1);
-            #endif
-            PRINTF(" ");
-          }
-        }
-        if(additional_bytes > 0)
-        {
-          PRINTF("0x");
-          for(j = 0; j < additional_bytes; j++)
-            PRINTF("%02X", pad_byte);
-        }
+        uint32_t bytes = (length+7)/8;
+        uint8_t tdo = bitseq_digits(ir ? &ctx->bs_sir : &ctx->bs_sdr, BSF_TDO) > 0;
+        ctx->sink->scan(ctx->sink->user, ir, length, ctx->pack,
+          tdo ? ctx->pack + bytes : NULL, tdo ? ctx->pack + 2*bytes : NULL, endstate);
       }
-      #endif
+      break;
+    case CMD_STATE:
+      if(ctx->sink->state)
+        ctx->sink->state(ctx->sink->user, ctx->state_path, ctx->state_path_len);
+      break;
+    case CMD_RUNTEST:
+      if(ctx->sink->runtest)
+        ctx->sink->runtest(ctx->sink->user, ctx->runtest.run_state, ctx->runtest.run_count, ctx->runtest.min_us,
+          ctx->runtest.end_state < 0 ? ctx->runtest.run_state : ctx->runtest.end_state);
+      break;
+    default:
+      break;
+  }
+}
+
+// make room for the segments of one scan, descriptors
+// must not move while chained. all taken are given back
+// return value:
+// 0 - ok
+// -1 - memory allocation failed
+static int8_t scan_segments(struct S_svfparser *ctx, uint32_t need)
+{
+  ctx->jtag_seg_used = 0;
+  if(need > ctx->jtag_seg_allocated)
+  {
+    struct S_jtaghw *seg = (struct S_jtaghw *)realloc(ctx->jtag_seg, need * sizeof(struct S_jtaghw));
+    if(seg == NULL)
+    {
+      TRACE_PLAY(ctx, TR_ALLOC, 0, need * sizeof(struct S_jtaghw), 0);
+      PRINTF("Memory Allocation Failed\n");
+      return -1;
+    }
+    ctx->jtag_seg = seg;
+    ctx->jtag_seg_allocated = need;
+    ctx->stats.reallocs++;
+  }
+  return 0;
+}
+
+// segments reserved for splitting bitfield i:
+// one per chunk and fill page, one more for each
+static uint32_t bitseq_segments_max(struct S_bitseq *seq, int i)
+{
+  if(seq->length == 0)
+    return 0;
+  return seq->allocated[i] / SVF_CHUNK_BYTES + 2 + seq->length / 8 / SVFSCAN_FILL_BYTES + 1;
+}
+
+// take a cleared segment from the reserved ones
+static struct S_jtaghw *scan_segment(struct S_svfparser *ctx)
+{
+  struct S_jtaghw *hw = &ctx->jtag_seg[ctx->jtag_seg_used++];
+  memset(hw, 0, sizeof(struct S_jtaghw));
+  return hw;
+}
+
+// split n data bytes of bitfield i starting at byte first
+// into segments at chunk boundaries. first segment is
+// hw, others are taken from the reserved ones.
+// return value: last segment (for the trailer)
+static struct S_jtaghw *bitseq_segments(struct S_svfparser *ctx, struct S_bitseq *seq, int i,
+  struct S_jtaghw *hw, uint32_t first, int32_t n)
+{
+  while(n > 0)
+  {
+    uint32_t run = SVF_CHUNK_BYTES - first % SVF_CHUNK_BYTES;
+    if(run > (uint32_t)n)
+      run = n;
+    if(hw->data_bytes != 0)
+    {
+      // next chunk: new segment chained to the previous one
+      struct S_jtaghw *next = scan_segment(ctx);
+      hw->next = next;
+      hw = next;
+    }
+    hw->data = bitseq_byte(seq, i, first);
+    hw->data_bytes = run;
+    first += run;
+    n -= run;
+  }
+  return hw;
+}
+
+// padding: bits of constant pad byte as fill segments
+// chained after hw, TDI comes from the shared fill page
+// return value: last segment
+static struct S_jtaghw *scan_fill(struct S_svfparser *ctx, struct S_jtaghw *hw, uint8_t pad, uint32_t bits)
+{
+  uint8_t *page = svfscan_fill(pad);
+  while(bits > 0)
+  {
+    struct S_jtaghw *fill = scan_segment(ctx);
+    uint32_t bytes = bits / 8 < SVFSCAN_FILL_BYTES ? bits / 8 : SVFSCAN_FILL_BYTES;
+    fill->fill = 1;
+    if(bytes > 0)
+    {
+      fill->data = page;
+      fill->data_bytes = bytes;
+      bits -= 8 * bytes;
+    }
+    if(bits < 8 && bits > 0)
+    {
+      fill->trailer = page;
+      fill->trailer_bits = bits;
+      bits = 0;
+    }
+    hw->next = fill;
+    hw = fill;
+  }
+  return hw;
+}
+
+// describe bitfield i in shift order starting from the least
+// significant given digit: header nibble, complete bytes (one
+// segment per chunk), trailer bits and fill segments for padding.
+// hw is the cleared first segment
+// return value: last segment
+static struct S_jtaghw *bitseq_split(struct S_svfparser *ctx, struct S_bitseq *seq, int i, struct S_jtaghw *hw)
+{
+  int32_t digitlen = bitseq_digits(seq, i);
+  uint32_t first = seq->digitindex[i]+1; // insertion index of the least significant digit
+  // bits from memory, the rest is padding
+  uint32_t given = 4 * (digitlen > 0 ? digitlen : 0);
+  if(given > seq->length)
+    given = seq->length;
+  uint32_t bits = given; // not yet placed
+  struct S_jtaghw *last = hw;
+  uint8_t pad = i == BSF_MASK || i == BSF_SMASK ? 0xFF : 0x00;
+  uint32_t b = first/2; // byte index into the field
+  if((first & 1) != 0 && bits > 0)
+  {
+    // least significant digit is in the upper nibble
+    hw->header = bitseq_byte(seq, i, b++);
+    hw->header_bits = 4;
+    bits -= 4;
+  }
+  if(bits >= 8)
+  {
+    last = bitseq_segments(ctx, seq, i, hw, b, bits/8);
+    b += bits/8;
+  }
+  if((bits & 7) != 0)
+  {
+    last->trailer = bitseq_byte(seq, i, b);
+    last->trailer_bits = bits & 7;
+  }
+  TRACE_PLAY(ctx, TR_SPLIT, i, digitlen, seq->length - given);
+  return scan_fill(ctx, last, pad, seq->length - given);
+}
+
+// TMS burst from the TAP engine, in order with the scans
+static void play_tms(void *user, uint8_t *tms, uint32_t bits)
+{
+  struct S_svfparser *ctx = (struct S_svfparser *)user;
+  PROFILE_ENTER(ctx, STAGE_BACKEND);
+  if(ctx->pipe)
+    svfpipe_push_tms(ctx->pipe, tms, bits);
+  else
+    jtag_tms(tms, bits);
+  PROFILE_LEAVE(ctx);
+}
+
+// RUNTEST in the current TAP state, in order with the scans.
+// clocks and wait time are left to the backend
+static void play_runtest(struct S_svfparser *ctx, uint32_t clocks, uint32_t min_us)
+{
+  uint8_t state = ctx->tap.state;
+  if(svftap_next(state, 0) != state && svftap_next(state, 1) != state)
+    return; // not a stable state
+  svftap_flush(&ctx->tap); // moves to the run state first
+  PROFILE_ENTER(ctx, STAGE_BACKEND);
+  if(ctx->pipe)
+    svfpipe_push_runtest(ctx->pipe, state, clocks, min_us);
+  else
+    jtag_runtest(state, clocks, min_us);
+  PROFILE_LEAVE(ctx);
+}
+
+// shift now or queue for the driver thread.
+// the last bit leaves Shift, then the TAP walks to endstate.
+// check: expected TDO of the scan, NULL if none
+void play_scan(struct S_svfparser *ctx, struct S_jtaghw *tdi, uint8_t endstate, struct S_svfcheck *check)
+{
+  struct S_jtaghw *last = tdi;
+  svftap_flush(&ctx->tap); // pending moves first
+  for(; last->next != NULL; last = last->next)
+    last->tms_exit = 0; // cached segment may have been last before
+  int8_t post = svftap_exit(&ctx->tap, endstate, &last->tms_post);
+  last->tms_exit = post >= 0;
+  last->tms_post_bits = post > 0 ? post : 0;
+  if(ctx->pipe)
+  {
+    PROFILE_ENTER(ctx, STAGE_BACKEND);
+    svfpipe_push(ctx->pipe, tdi, check);
+    PROFILE_LEAVE(ctx);
+    return;
+  }
+  if(check != NULL)
+    jtag_expect(check->tdo, check->mask, check->length);
+  else
+    jtag_expect(NULL, NULL, 0);
+  // deferred: TDO is captured to the check queue
+  uint8_t verify = check != NULL && !ctx->verify.off;
+  struct S_jtaghw *tdo = verify && ctx->verify.deferred
+    ? svfverify_defer(&ctx->verify, tdi, check) : svfscan_capture(&ctx->capture, tdi);
+  if(tdo == NULL)
+  {
+    PRINTF("Memory Allocation Failed\n");
+    return;
+  }
+  PROFILE_ENTER(ctx, STAGE_BACKEND);
+  uint64_t t = svfstats_now();
+  int32_t chunks = svfscan_shift(&ctx->chunks, tdi, tdo, ctx->max_transfer);
+  svfstats_latency(&ctx->stats.shift, svfstats_now() - t);
+  PROFILE_LEAVE(ctx);
+  if(chunks < 0)
+  {
+    PRINTF("Memory Allocation Failed\n");
+    return;
+  }
+  if(verify && !ctx->verify.deferred)
+    svfverify_scan(&ctx->verify, tdo, check);
+}
+
+// split TDI, TDO and MASK are packed for the check. TDI
+// of the header command (HIR/HDR) is shifted first, then
+// the scan, then the trailer command (TIR/TDR), all
+// chained into one transfer without copying
+void play_bitsequence(struct S_svfparser *ctx, struct S_bitseq *head, struct S_bitseq *seq,
+  struct S_bitseq *tail, uint8_t endstate)
+{
+  int tdo_digitlen = bitseq_digits(seq, BSF_TDO);
+  if(seq->length == 0)
+    return;
+  if(seq->allocated[BSF_TDI] == 0 || seq->field[BSF_TDI] == NULL)
+    return; // not allocated
+  if(scan_segments(ctx, bitseq_segments_max(head, BSF_TDI) + bitseq_segments_max(seq, BSF_TDI)
+    + bitseq_segments_max(tail, BSF_TDI)) < 0)
+    return;
+
+  // same short field was split before: play it as it was
+  struct S_svfcache_scan *slot = NULL;
+  struct S_jtaghw *scan = NULL, *last;
+  if(seq->allocated[BSF_TDI] <= SVFCACHE_MAX_BYTES)
+    scan = svfcache_scan_get(&ctx->cache, tdo_digitlen > 0, seq->length, seq->digitindex[BSF_TDI],
+      seq->field[BSF_TDI][0], seq->allocated[BSF_TDI], &slot);
+  if(scan != NULL)
+    TRACE_PLAY(ctx, TR_CACHED, BSF_TDI, 0, 0);
+  else
+  {
+    scan = &ctx->jtag_tdi;
+    memset(scan, 0, sizeof(struct S_jtaghw));
+    bitseq_split(ctx, seq, BSF_TDI, scan);
+    if(slot != NULL)
+      svfcache_scan_put(slot, scan, seq->field[BSF_TDI][0]);
+  }
+  for(last = scan; last->next != NULL; last = last->next);
+  if(head->length > 0)
+  {
+    struct S_jtaghw *hw = scan_segment(ctx);
+    bitseq_split(ctx, head, BSF_TDI, hw)->next = scan;
+    scan = hw;
+  }
+  if(tail->length > 0)
+  {
+    last->next = scan_segment(ctx);
+    bitseq_split(ctx, tail, BSF_TDI, last->next);
+  }
+  // expected TDO and MASK packed like the captured bits
+  struct S_svfcheck check, *pcheck = NULL;
+  ctx->scans++;
+  if(tdo_digitlen > 0)
+  {
+    int64_t length = scan_pack(ctx, head, seq, tail, 0);
+    if(length >= 0)
+    {
+      uint32_t bytes = (length+7)/8;
+      check.scan = ctx->scans;
+      check.command = ctx->commands;
+      check.line = ctx->line_count + 1; // line of the ;
+      check.length = length;
+      check.tdo = ctx->pack + bytes;
+      check.mask = ctx->pack + 2*bytes;
+      pcheck = &check;
     }
-    PRINTF("\n");
-    jtag_tdi_tdo(&JTAG_TDI, &JTAG_TDO);
   }
+  PROFILE_BYTES(ctx, STAGE_SPLIT, (head->length + seq->length + tail->length + 7) / 8);
+  PROFILE_BYTES(ctx, STAGE_BACKEND, (head->length + seq->length + tail->length + 7) / 8);
+  play_scan(ctx, scan, endstate, pcheck);
+  last->next = NULL; // cached scan is chained again next time
 }
 
-void play_buffer()
+// counters of the completed command
+static void stats_command(struct S_svfparser *ctx)
 {
-  if(Completed_command == CMD_SIR)
+  struct S_svfstats *st = &ctx->stats;
+  uint8_t ir = ctx->completed_command == CMD_SIR;
+  if(ctx->completed_command >= CMD_NUM)
+    return;
+  st->commands[ctx->completed_command]++;
+  if(ir)
+    st->scan_bits[1] += ctx->bs_hir.length + ctx->bs_sir.length + ctx->bs_tir.length;
+  else if(ctx->completed_command == CMD_SDR)
+    st->scan_bits[0] += ctx->bs_hdr.length + ctx->bs_sdr.length + ctx->bs_tdr.length;
+  else
+    return;
+  st->scans[ir]++;
+}
+
+void play_buffer(struct S_svfparser *ctx)
+{
+  ctx->commands++;
+  stats_command(ctx);
+  if(ctx->sink)
   {
-    PRINTF("SIR buffer:\n");
-    play_bitsequence(&BS_sir);
+    sink_command(ctx);
+    return;
+  }
+  struct S_runtest *rt = &ctx->runtest;
+  switch(ctx->completed_command)
+  {
+    case CMD_SIR:
+      TRACE_PLAY(ctx, TR_SCAN, 1, ctx->bs_hir.length + ctx->bs_sir.length + ctx->bs_tir.length,
+        ctx->endxr_state[ENDX_ENDIR]);
+      svftap_goto(&ctx->tap, LIBXSVF_TAP_IRSHIFT);
+      play_bitsequence(ctx, &ctx->bs_hir, &ctx->bs_sir, &ctx->bs_tir, ctx->endxr_state[ENDX_ENDIR]);
+      svftap_goto(&ctx->tap, ctx->endxr_state[ENDX_ENDIR]); // when no TDI was shifted
+      break;
+    case CMD_SDR:
+      TRACE_PLAY(ctx, TR_SCAN, 0, ctx->bs_hdr.length + ctx->bs_sdr.length + ctx->bs_tdr.length,
+        ctx->endxr_state[ENDX_ENDDR]);
+      svftap_goto(&ctx->tap, LIBXSVF_TAP_DRSHIFT);
+      play_bitsequence(ctx, &ctx->bs_hdr, &ctx->bs_sdr, &ctx->bs_tdr, ctx->endxr_state[ENDX_ENDDR]);
+      svftap_goto(&ctx->tap, ctx->endxr_state[ENDX_ENDDR]); // when no TDI was shifted
+      break;
+    case CMD_STATE:
+      svftap_path(&ctx->tap, ctx->state_path, ctx->state_path_len);
+      break;
+    case CMD_RUNTEST:
+      TRACE_PLAY(ctx, TR_RUNTEST, rt->run_state, rt->run_count, rt->min_us);
+      svftap_goto(&ctx->tap, rt->run_state);
+      play_runtest(ctx, rt->run_count, rt->min_us);
+      svftap_goto(&ctx->tap, rt->end_state < 0 ? rt->run_state : rt->end_state);
+      break;
+    default:
+      break;
   }
-  if(Completed_command == CMD_SDR)
+}
+
+// perfect hash of reserved words: packed first
+// CMDS_ENOUGH_CHARS chars, last char and length,
+// multiplied by the magic which is collision-free
+// for each of the keyword lists (checked at compile time)
+#define KW_HASH_BITS 5
+#define KW_MAGIC 0x62FBBC2Bu
+
+constexpr uint32_t kw_hash(const char *name)
+{
+  uint32_t prefix = 0, len = 0;
+  for(; name[len] != '\0'; len++)
+    if(len < CMDS_ENOUGH_CHARS)
+      prefix |= (uint32_t)(uint8_t)name[len] << (8*len);
+  if(len == 0)
+    return 0;
+  return (uint32_t)((prefix ^ ((uint32_t)(uint8_t)name[len-1] << 3) ^ len) * KW_MAGIC) >> (32 - KW_HASH_BITS);
+}
+
+// keyword list with its hash table
+struct S_keywords
+{
+  const char *const *name; // array of strings, null pointer terminated
+  int8_t slot[1 << KW_HASH_BITS]; // token+1 at hash of the name, 0 if empty
+  int8_t collisions; // must be 0
+};
+
+constexpr struct S_keywords keywords(const char *const *name)
+{
+  struct S_keywords kw = { name, {0}, 0 };
+  for(int i = 0; name[i] != NULL; i++)
   {
-    PRINTF("SDR buffer:\n");
-    play_bitsequence(&BS_sdr);
+    uint32_t h = kw_hash(name[i]);
+    if(kw.slot[h] != 0)
+      kw.collisions++;
+    kw.slot[h] = i + 1;
   }
+  return kw;
 }
 
+constexpr struct S_keywords Commands_kw = keywords(Svf_command_name);
+constexpr struct S_keywords Tap_states_kw = keywords(Svf_tap_state_name);
+constexpr struct S_keywords bsf_name_kw = keywords(Svf_field_name);
+constexpr struct S_keywords runtest_words_kw = keywords(runtest_words);
+static_assert(Commands_kw.collisions == 0 && Tap_states_kw.collisions == 0
+  && bsf_name_kw.collisions == 0 && runtest_words_kw.collisions == 0,
+  "KW_MAGIC is not a perfect hash for the reserved words");
+
 // search command
 // >= 0 : tokenized command
 // < 0 : command not found
-// list is array of strings, null pointer terminated
-int8_t search_name(char *cmd, const char *list[])
+// single probe into the hash table,
+// then compare to reject unknown words
+int8_t search_name(const char *cmd, const struct S_keywords *kw)
 {
   // PRINTF("<SEARCH %s>", cmd);
-  int i;
-  for(i = 0; list[i] != NULL; i++)
-    if(strcmp(cmd, list[i]) == 0)
-      return i;
+  int8_t token = kw->slot[kw_hash(cmd)] - 1;
+  if(token >= 0 && strcmp(cmd, kw->name[token]) == 0)
+    return token;
   return -1;
 }
 
-
 /* ******************* BEGIN COMMAND SERVICE FUNCTIONS ******************* */
 /*
 input: '!' - resets global parser state
@@ -699,8 +991,17 @@ return value:
        0 - ok
       <0 - error
 */
+/*
+optional span variant, for speed:
+input: rest of the packet, raw (not uppercased) text
+return value:
+       number of leading chars consumed, must stop
+       at any char which is not part of the current
+       number or value (space, comment, bracket, ';')
+       0 - nothing consumed, continue char by char
+*/
 
-int8_t cmd_pio(char c)
+int8_t cmd_pio(struct S_svfparser *ctx, char c)
 {
   puts("PIO NOT SUPPORTED");
   return 0;
@@ -709,19 +1010,15 @@ int8_t cmd_pio(char c)
 
 // common parser for
 // HDR,HIR,SDR,SIR,TDR,TIR
-int8_t cmd_bitsequence(char c, struct S_bitseq *seq)
+int8_t cmd_bitsequence(struct S_svfparser *ctx, char c, struct S_bitseq *seq)
 {
-  static int8_t state = BSPS_INIT;
-  static int bfnamelen = 0;
-  static char bfname[BF_NAME_MAXLEN+1];
-  static int8_t tbfname = -1; // tokenized bitfield name
-  static int32_t digitindex = -1; // countdown hex digits of the bitfield
+  struct S_bitseq_parser *bsp = &ctx->bsp;
   if(c == '\0')
-  { // reset parsing state
-    state = 0;
-    bfnamelen = 0;
-    tbfname = -1;
-    digitindex = 0;
+  { // reset parsing bsp.state
+    bsp->state = 0;
+    bsp->bfnamelen = 0;
+    bsp->tbfname = -1;
+    bsp->digitindex = 0;
     // TDI, MASK, SMASK are sticky and remembered from previous SVF command
     // TDO is not remembered between SVF commands
     seq->digitindex[BSF_TDO] = seq->allocated[BSF_TDO]*2-1;
@@ -729,21 +1026,21 @@ int8_t cmd_bitsequence(char c, struct S_bitseq *seq)
   }
   if(c == '!')
   { // complete reset, forgets everything
-    state = 0;
-    bfnamelen = 0;
-    tbfname = -1;
-    digitindex = 0;
+    bsp->state = 0;
+    bsp->bfnamelen = 0;
+    bsp->tbfname = -1;
+    bsp->digitindex = 0;
     for(int i = 0; i < BSF_NUM; i++)
       seq->digitindex[i] = 0;
     seq->length = 0;
     return 0;
   }
-  switch(state)
+  switch(bsp->state)
   {
     case BSPS_INIT:
       if(c == ';')
       {
-        state = BSPS_ERROR;
+        bsp->state = BSPS_ERROR;
         break;
       }
       // look for first char of the length
@@ -751,7 +1048,7 @@ int8_t cmd_bitsequence(char c, struct S_bitseq *seq)
       {
         // take first digit
         seq->length = c - '0';
-        state = BSPS_LENGTH;
+        bsp->state = BSPS_LENGTH;
       }
       break;
     case BSPS_LENGTH:
@@ -764,11 +1061,11 @@ int8_t cmd_bitsequence(char c, struct S_bitseq *seq)
       }
       if(c == ' ')
       { // space - end of length, proceed getting the name
-        PRINTF("L%d", seq->length);
-        bfname[0] = '\0';
-        bfnamelen = 0;
-        tbfname = -1;
-        state = BSPS_NAME;
+        TRACE(ctx, TR_LENGTH, 0, seq->length, 0);
+        bsp->bfname[0] = '\0';
+        bsp->bfnamelen = 0;
+        bsp->tbfname = -1;
+        bsp->state = BSPS_NAME;
         // if length has changed, then reset remembered fields
         for(int i = 0; i < BSF_NUM; i++)
           if(seq->length_prev[i] != seq->length)
@@ -782,129 +1079,120 @@ int8_t cmd_bitsequence(char c, struct S_bitseq *seq)
       {
         if(seq->length == 0)
         {
-          PRINTF("L%d", seq->length);
-          state = BSPS_COMPLETE;
+          TRACE(ctx, TR_LENGTH, 0, seq->length, 0);
+          bsp->state = BSPS_COMPLETE;
         }
         else
-          state = BSPS_ERROR;
+          bsp->state = BSPS_ERROR;
         break;          
       }
       break;
     case BSPS_NAME:
       if(c == ' ')
       {
-        bfname[bfnamelen] = '\0'; // 0-terminate
-        tbfname = search_name(bfname, bsf_name);
-        if(tbfname >= 0)
-          PRINTF("tbfname '%s'", bsf_name[tbfname]);
-        state = BSPS_VALUEOPEN;
+        bsp->bfname[bsp->bfnamelen] = '\0'; // 0-terminate
+        bsp->tbfname = search_name(bsp->bfname, &bsf_name_kw);
+        if(bsp->tbfname >= 0)
+          TRACE(ctx, TR_FIELD, bsp->tbfname, 0, 0);
+        bsp->state = BSPS_VALUEOPEN;
         break;
       }
       if(c >= 'A' && c <= 'Z')
       {
-        if(bfnamelen < BF_NAME_MAXLEN)
-          bfname[bfnamelen++] = c;
+        if(bsp->bfnamelen < BF_NAME_MAXLEN)
+          bsp->bfname[bsp->bfnamelen++] = c;
         else
         {
           // name too long, error
-          bfname[bfnamelen] = '\0'; // 0-terminate
-          state = BSPS_ERROR;
+          bsp->bfname[bsp->bfnamelen] = '\0'; // 0-terminate
+          bsp->state = BSPS_ERROR;
         }
         break;
       }
-      state = BSPS_ERROR;
+      bsp->state = BSPS_ERROR;
       break;
     case BSPS_VALUEOPEN:
       if(c == '(')
       {
         // sanity check: we must know bitfield name
         // and have it tokenized, otherwise it's error
-        if(tbfname < 0)
+        if(bsp->tbfname < 0)
         {
-          state = BSPS_ERROR;
+          bsp->state = BSPS_ERROR;
           break;        
         }
-        digitindex = (seq->length+3)/4-1; // start inserting at highest position downwards
-        PRINTF("open");
-        state = BSPS_VALUE;
-        // it is allowed to allocate less than required length
-        // just issue some warnings
-        // realloc to length now
+        bsp->digitindex = (seq->length+3)/4-1; // start inserting at highest position downwards
+        TRACE(ctx, TR_OPEN, bsp->tbfname, bsp->digitindex + 1, 0);
+        bsp->state = BSPS_VALUE;
         // calculate bytes needed to allocate
         uint32_t alloc_bytes = (seq->length+7)/8;
-        // apply MAX alloc limit
-        if(alloc_bytes > MAX_alloc)
-        {
-          PRINTF("WARNING: required %d bytes for bitfield exceeds limit. Allocating only %d bytes\n",
-            alloc_bytes, MAX_alloc);
-          alloc_bytes = MAX_alloc;
-        }
-        // realloc now the bitfield
-        seq->field[tbfname] = (uint8_t *)realloc(seq->field[tbfname], alloc_bytes);
-        if(seq->field[tbfname] == NULL)
+        // add chunks to the bitfield if needed
+        if(bitseq_alloc(ctx, seq, bsp->tbfname, alloc_bytes) < 0)
         {
+          TRACE(ctx, TR_ALLOC, 0, alloc_bytes, 0);
           PRINTF("Memory Allocation Failed\n");
-          state = BSPS_ERROR;
+          bsp->state = BSPS_ERROR;
           break;
         }
-        seq->allocated[tbfname] = alloc_bytes; // track how much is allocated
-        seq->digitindex[tbfname] = digitindex; // insertion point start from highest byte
+        seq->digitindex[bsp->tbfname] = bsp->digitindex; // insertion point start from highest byte
         // when length has changed then reset bit field to its default value
-        if(seq->length_prev[tbfname] != seq->length)
+        if(seq->length_prev[bsp->tbfname] != seq->length)
         {
           // when length changes, default MASK and SMASK is set to all cares 0xFF
-          if(tbfname == BSF_MASK || tbfname == BSF_SMASK)
-            memset(seq->field[tbfname], 0xFF, seq->allocated[tbfname]);
+          if(bsp->tbfname == BSF_MASK || bsp->tbfname == BSF_SMASK)
+            for(uint32_t j = 0; j < seq->chunks[bsp->tbfname]; j++)
+              memset(seq->field[bsp->tbfname][j], 0xFF, SVF_CHUNK_BYTES);
         }
-        seq->length_prev[tbfname] = seq->length;
+        seq->length_prev[bsp->tbfname] = seq->length;
       }
       else
-        state = BSPS_ERROR;
+        bsp->state = BSPS_ERROR;
       break;
     case BSPS_VALUE:
       // sanity check: we must know bitfield name
       // and have it tokenized, otherwise it's error
       if( (c >= '0' && c <= '9') || (c >= 'A' && c <= 'F') )
       {
-        if(tbfname < 0)
+        if(bsp->tbfname < 0)
         {
-          state = BSPS_ERROR;
+          bsp->state = BSPS_ERROR;
           break;        
         }
         // fill hex into allocated space
         // conversion from ascii to hex digit (binary lower 4-bits)
-        #if REVERSE_NIBBLE
-        uint8_t hexdigit = ReverseNibble[c < 'A' ? c - '0' : c + 10 - 'A'];
-        #else
         uint8_t hexdigit = c < 'A' ? c - '0' : c + 10 - 'A';
-        #endif
-        if( digitindex >= 0 )
+        if(ctx->msb_first)
+          hexdigit = ReverseNibble[hexdigit];
+        if( bsp->digitindex >= 0 )
         {
           // buffer the data for later use
           // don't exceed the allocated length
-          uint32_t byteindex = digitindex/2;
-          if( byteindex < seq->allocated[tbfname] )
+          uint32_t byteindex = bsp->digitindex/2;
+          if( byteindex < seq->allocated[bsp->tbfname] )
           {
             uint8_t value_byte;
-            // PRINTF("add digit #%d %s %X\n", digitindex, bsf_name[tbfname], hexdigit);
-            #if REVERSE_NIBBLE
-            if( (digitindex & 1) != 0 )
-              value_byte = hexdigit; // with 4 bit leading zeros
-            else
-              value_byte = (seq->field[tbfname][byteindex] & 0xF) | (hexdigit<<4);
-            #else
-            if( (digitindex & 1) != 0 )
-              value_byte = hexdigit << 4;
+            // PRINTF("add digit #%d %s %X\n", bsp.digitindex, Svf_field_name[bsp.tbfname], hexdigit);
+            if(ctx->msb_first)
+            {
+              if( (bsp->digitindex & 1) != 0 )
+                value_byte = hexdigit; // with 4 bit leading zeros
+              else
+                value_byte = (*bitseq_byte(seq, bsp->tbfname, byteindex) & 0xF) | (hexdigit<<4);
+            }
             else
-              value_byte = (seq->field[tbfname][byteindex] & 0xF0) | (hexdigit); // with 4 bit leading zeros
-            #endif
-            seq->field[tbfname][byteindex] = value_byte;
-            // PRINTF("written %s[%d]=%02X\n", bsf_name[tbfname] , byteindex, value_byte);
-            seq->digitindex[tbfname] = --digitindex;
+            {
+              if( (bsp->digitindex & 1) != 0 )
+                value_byte = hexdigit << 4;
+              else
+                value_byte = (*bitseq_byte(seq, bsp->tbfname, byteindex) & 0xF0) | (hexdigit); // with 4 bit leading zeros
+            }
+            *bitseq_byte(seq, bsp->tbfname, byteindex) = value_byte;
+            // PRINTF("written %s[%d]=%02X\n", Svf_field_name[bsp.tbfname] , byteindex, value_byte);
+            seq->digitindex[bsp->tbfname] = --bsp->digitindex;
           }
         }
         else
-          PRINTF("********** OVERRUN %d **********\n", digitindex);
+          TRACE(ctx, TR_OVERRUN, bsp->tbfname, bsp->digitindex, 0);
         break;
       }
       if(c == ')')
@@ -912,212 +1200,329 @@ int8_t cmd_bitsequence(char c, struct S_bitseq *seq)
         #if 0
         // disabled - let's do it at output
         // write leading zeros for unspecified hex digits
-        if( digitindex >= 0 )
+        if( bsp->digitindex >= 0 )
         {
-          uint32_t byteindex = digitindex/2;
-          if( byteindex < seq->allocated[tbfname] )
+          uint32_t byteindex = bsp->digitindex/2;
+          if( byteindex < seq->allocated[bsp->tbfname] )
           {
             int i;
             for(i = 0; i <= byteindex; i++)
-              seq->field[tbfname][i] = 0; // leading zeros
+              *bitseq_byte(seq, bsp->tbfname, i) = 0; // leading zeros
           }
-          seq->digitindex[tbfname] = -1;
+          seq->digitindex[bsp->tbfname] = -1;
         }
         #endif
-        PRINTF("close");
-        bfname[0] = '\0';
-        bfnamelen = 0;
-        tbfname = -1;
-        state = BSPS_NAME1; // expect another name
+        TRACE(ctx, TR_CLOSE, bsp->tbfname, bsp->digitindex + 1, 0);
+        bsp->bfname[0] = '\0';
+        bsp->bfnamelen = 0;
+        bsp->tbfname = -1;
+        bsp->state = BSPS_NAME1; // expect another name
         break;
       }
-      state = BSPS_ERROR;
+      bsp->state = BSPS_ERROR;
       break;
     case BSPS_NAME1:
       if(c == ' ') // ignore space
         break;
       if(c >= 'A' && c <= 'Z')
       {
-        if(bfnamelen < BF_NAME_MAXLEN)
+        if(bsp->bfnamelen < BF_NAME_MAXLEN)
         {
-          bfname[bfnamelen++] = c;
-          state = BSPS_NAME;
+          bsp->bfname[bsp->bfnamelen++] = c;
+          bsp->state = BSPS_NAME;
         }
         else
         {
           // name too long, error
-          bfname[bfnamelen] = '\0'; // 0-terminate
-          state = BSPS_ERROR;
+          bsp->bfname[bsp->bfnamelen] = '\0'; // 0-terminate
+          bsp->state = BSPS_ERROR;
         }
         break;
       }
-      state = BSPS_ERROR;
+      bsp->state = BSPS_ERROR;
       break;
     default:
-      state = BSPS_ERROR;
+      bsp->state = BSPS_ERROR;
       break;
   }
   // PRINTF("%c*", c);
   return 0;
 }
 
-int8_t cmd_hdr(char c)
+// span variant of cmd_bitsequence: consumes leading
+// chars of s which continue the length or the hex value
+// return value: number of chars consumed,
+// 0 if the next char needs per-char parsing
+uint32_t cmd_bitsequence_span(struct S_svfparser *ctx, const uint8_t *s, uint32_t n, struct S_bitseq *seq)
+{
+  struct S_bitseq_parser *bsp = &ctx->bsp;
+  uint32_t j, decoded = 0, whole = 0;
+  uint8_t *cached;
+  switch(bsp->state)
+  {
+    case BSPS_LENGTH:
+      for(j = 0; j < n && s[j] >= '0' && s[j] <= '9'; j++)
+        seq->length = (seq->length * 10) + s[j] - '0';
+      return j;
+    case BSPS_VALUE:
+      if(bsp->tbfname < 0)
+        return 0; // per-char parsing reports the error
+      // whole value of a short field in this span:
+      // take the decoded bytes from the cache
+      if(bsp->digitindex == (int32_t)(seq->length+3)/4-1 && seq->allocated[bsp->tbfname] <= SVFCACHE_MAX_BYTES)
+      {
+        j = hex_span(s, n);
+        if(j > 0 && j < n && (int32_t)j <= bsp->digitindex+1)
+        {
+          whole = j;
+          cached = svfcache_value_get(&ctx->cache, ctx->command, bsp->tbfname, seq->length, s, whole);
+          if(cached != NULL)
+          {
+            memcpy(seq->field[bsp->tbfname][0], cached, seq->allocated[bsp->tbfname]);
+            bsp->digitindex -= whole;
+            seq->digitindex[bsp->tbfname] = bsp->digitindex;
+            return whole;
+          }
+        }
+      }
+      // decode chunk by chunk, hex_decode() stops
+      // after writing the lowest digit of the chunk
+      while(bsp->digitindex >= 0 && (uint32_t)(bsp->digitindex/2) < seq->allocated[bsp->tbfname])
+      {
+        uint32_t chunk = bsp->digitindex / (2*SVF_CHUNK_BYTES);
+        int32_t base = chunk * 2*SVF_CHUNK_BYTES; // digit index of the chunk start
+        PROFILE_ENTER(ctx, STAGE_HEX);
+        j = hex_decode(seq->field[bsp->tbfname][chunk], bsp->digitindex - base, s + decoded, n - decoded,
+          ctx->msb_first);
+        PROFILE_LEAVE(ctx);
+        PROFILE_BYTES(ctx, STAGE_HEX, j);
+        bsp->digitindex -= j;
+        decoded += j;
+        seq->digitindex[bsp->tbfname] = bsp->digitindex;
+        if(bsp->digitindex >= base)
+          break; // stopped at non-hex char
+      }
+      if(whole != 0)
+        svfcache_value_put(&ctx->cache, ctx->command, bsp->tbfname, seq->length, s, whole,
+          seq->field[bsp->tbfname][0], seq->allocated[bsp->tbfname]);
+      if(bsp->digitindex >= 0)
+        return decoded;
+      // no space left: skip the rest of the hex digits
+      j = hex_span(s + decoded, n - decoded);
+      if(j > 0 && bsp->digitindex < 0)
+        TRACE(ctx, TR_OVERRUN, bsp->tbfname, bsp->digitindex, j);
+      return decoded + j;
+    default:
+      return 0;
+  }
+}
+
+int8_t cmd_hdr(struct S_svfparser *ctx, char c)
+{
+  return cmd_bitsequence(ctx, c, &ctx->bs_hdr);
+}
+
+uint32_t cmd_hdr_span(struct S_svfparser *ctx, const uint8_t *s, uint32_t n)
+{
+  return cmd_bitsequence_span(ctx, s, n, &ctx->bs_hdr);
+}
+
+int8_t cmd_hir(struct S_svfparser *ctx, char c)
+{
+  return cmd_bitsequence(ctx, c, &ctx->bs_hir);
+}
+
+uint32_t cmd_hir_span(struct S_svfparser *ctx, const uint8_t *s, uint32_t n)
+{
+  return cmd_bitsequence_span(ctx, s, n, &ctx->bs_hir);
+}
+
+int8_t cmd_sdr(struct S_svfparser *ctx, char c)
+{
+  return cmd_bitsequence(ctx, c, &ctx->bs_sdr);
+}
+
+uint32_t cmd_sdr_span(struct S_svfparser *ctx, const uint8_t *s, uint32_t n)
 {
-  return cmd_bitsequence(c, &BS_hdr);
+  return cmd_bitsequence_span(ctx, s, n, &ctx->bs_sdr);
 }
 
-int8_t cmd_hir(char c)
+int8_t cmd_sir(struct S_svfparser *ctx, char c)
 {
-  return cmd_bitsequence(c, &BS_hir);
+  return cmd_bitsequence(ctx, c, &ctx->bs_sir);
 }
 
-int8_t cmd_sdr(char c)
+uint32_t cmd_sir_span(struct S_svfparser *ctx, const uint8_t *s, uint32_t n)
 {
-  return cmd_bitsequence(c, &BS_sdr);
+  return cmd_bitsequence_span(ctx, s, n, &ctx->bs_sir);
 }
 
-int8_t cmd_sir(char c)
+int8_t cmd_tdr(struct S_svfparser *ctx, char c)
 {
-  return cmd_bitsequence(c, &BS_sir);
+  return cmd_bitsequence(ctx, c, &ctx->bs_tdr);
 }
 
-int8_t cmd_tdr(char c)
+uint32_t cmd_tdr_span(struct S_svfparser *ctx, const uint8_t *s, uint32_t n)
 {
-  return cmd_bitsequence(c, &BS_tdr);
+  return cmd_bitsequence_span(ctx, s, n, &ctx->bs_tdr);
 }
 
-int8_t cmd_tir(char c)
+int8_t cmd_tir(struct S_svfparser *ctx, char c)
 {
-  return cmd_bitsequence(c, &BS_tir);
+  return cmd_bitsequence(ctx, c, &ctx->bs_tir);
 }
 
-int8_t parse_float(char c)
+uint32_t cmd_tir_span(struct S_svfparser *ctx, const uint8_t *s, uint32_t n)
+{
+  return cmd_bitsequence_span(ctx, s, n, &ctx->bs_tir);
+}
+
+int8_t parse_float(struct S_svfparser *ctx, char c)
 {
   // static int8_t state = FLPS_INIT;
   if(c == '\0')
   { // reset parsing state
-    fl.state = FLPS_INIT;
-    fl.number = 0;
-    fl.frac = 0;
-    fl.expsign = 1;
-    fl.exponent = 0;
-    return fl.state;
+    ctx->fl.state = FLPS_INIT;
+    ctx->fl.number = 0;
+    ctx->fl.frac = 0;
+    ctx->fl.fracdigits = 0;
+    ctx->fl.expsign = 1;
+    ctx->fl.exponent = 0;
+    return ctx->fl.state;
   }
-  switch(fl.state)
+  switch(ctx->fl.state)
   {
     case FLPS_INIT:
       if(c >= '0' && c <= '9')
       {
-        fl.number = fl.number*10 + (c - '0');
-        fl.state = FLPS_NUM;
+        ctx->fl.number = ctx->fl.number*10 + (c - '0');
+        ctx->fl.state = FLPS_NUM;
         break;
       }
-      fl.state = FLPS_ERROR;
+      ctx->fl.state = FLPS_ERROR;
       break;
     case FLPS_NUM:
       if(c >= '0' && c <= '9')
       {
-        fl.number = fl.number*10 + (c - '0');
+        ctx->fl.number = ctx->fl.number*10 + (c - '0');
         break;
       }
       if(c == '.')
       {
-        fl.state = FLPS_FRAC;
+        ctx->fl.state = FLPS_FRAC;
         break;
       }
       if(c == 'E')
       {
-        fl.state = FLPS_EXP;
+        ctx->fl.state = FLPS_EXP;
         break;
       }
-      fl.state = FLPS_ERROR;
+      ctx->fl.state = FLPS_ERROR;
       break;
     case FLPS_FRAC:
       if(c >= '0' && c <= '9')
       {
-        fl.frac = fl.frac*10 + (c - '0');
+        ctx->fl.frac = ctx->fl.frac*10 + (c - '0');
+        ctx->fl.fracdigits++;
         break;
       }
       if(c == 'E')
       {
-        fl.state = FLPS_E;
+        ctx->fl.state = FLPS_E;
         break;
       }
-      fl.state = FLPS_ERROR;
+      ctx->fl.state = FLPS_ERROR;
       break;
     case FLPS_E:
       if(c >= '0' && c <= '9')
       {
-        fl.exponent = fl.exponent*10 + (c - '0');
-        fl.state = FLPS_EXP;
+        ctx->fl.exponent = ctx->fl.exponent*10 + (c - '0');
+        ctx->fl.state = FLPS_EXP;
         break;
       }
       if(c == '+')
       {
-        fl.expsign = 1;
-        fl.state = FLPS_EXP;
+        ctx->fl.expsign = 1;
+        ctx->fl.state = FLPS_EXP;
         break;
       }
       if(c == '-')
       {
-        fl.expsign = -1;
-        fl.state = FLPS_EXP;
+        ctx->fl.expsign = -1;
+        ctx->fl.state = FLPS_EXP;
         break;
       }
-      fl.state = FLPS_ERROR;
+      ctx->fl.state = FLPS_ERROR;
       break;
     case FLPS_EXP:
       if(c >= '0' && c <= '9')
       {
-        fl.exponent = fl.exponent*10 + (c - '0');
+        ctx->fl.exponent = ctx->fl.exponent*10 + (c - '0');
         break;
       }
-      fl.state = FLPS_ERROR;
+      ctx->fl.state = FLPS_ERROR;
       break;
     default:
-      fl.state = FLPS_ERROR;
+      ctx->fl.state = FLPS_ERROR;
   }
-  return fl.state;
+  return ctx->fl.state;
 }
 
-int8_t cmd_frequency(char c)
+// parsed float value converted to microseconds
+uint32_t float_microseconds(struct S_float *f)
 {
-  static int8_t state = FQPS_INIT;
-  static int8_t float_parsing_state = FLPS_INIT;
+  double value = f->number;
+  double div = 1;
+  int i, exp10 = f->expsign * f->exponent + 6;
+  for(i = 0; i < f->fracdigits; i++)
+    div *= 10;
+  value += f->frac / div;
+  for(; exp10 > 0; exp10--)
+    value *= 10;
+  for(; exp10 < 0; exp10++)
+    value /= 10;
+  if(value >= 4294967295.0)
+    return 0xFFFFFFFF;
+  return (uint32_t)(value + 0.5);
+}
+
+int8_t cmd_frequency(struct S_svfparser *ctx, char c)
+{
+  int8_t float_parsing_state;
   if(c == '\0')
   { // reset parsing state
-    state = FQPS_INIT;
-    parse_float('\0');
+    ctx->fqstate = FQPS_INIT;
+    parse_float(ctx, '\0');
     return 0;
   }
-  switch(state)
+  switch(ctx->fqstate)
   {
     case FQPS_INIT:
       if(c == ';')
       {
-        state = FQPS_COMPLETE;
+        ctx->fqstate = FQPS_COMPLETE;
         break;
       }
       if(c >= '0' && c <= '9')
       {
-        state = FQPS_VALUE;
-        float_parsing_state = parse_float(c);
+        ctx->fqstate = FQPS_VALUE;
+        float_parsing_state = parse_float(ctx, c);
         break;
       }
-      state = FQPS_ERROR;
+      ctx->fqstate = FQPS_ERROR;
       break;
     case FQPS_VALUE:
       if(c == ';')
       {
-        PRINTF("FLOAT %d.%dE%c%d ",
-          fl.number, fl.frac, fl.expsign > 0 ? '+' : '-', fl.exponent);
-        state = FQPS_COMPLETE;
+        PRINTF("FREQUENCY %d.%dE%c%d\n",
+          ctx->fl.number, ctx->fl.frac, ctx->fl.expsign > 0 ? '+' : '-', ctx->fl.exponent);
+        ctx->fqstate = FQPS_COMPLETE;
         break;
       }
-      float_parsing_state = parse_float(c);
+      float_parsing_state = parse_float(ctx, c);
       if(float_parsing_state == FLPS_ERROR)
       {
-        state = FQPS_ERROR;
+        ctx->fqstate = FQPS_ERROR;
         break;
       }
       break;
@@ -1129,55 +1534,52 @@ int8_t cmd_frequency(char c)
   return 0;
 }
 
-int8_t cmd_endxr(char c, uint8_t *endxr_s)
+int8_t cmd_endxr(struct S_svfparser *ctx, char c, uint8_t *endxr_s)
 {
-  static int8_t state = LIBXSVF_TAP_INIT;
-  static int endnamelen = 0;
-  static char endname[END_NAME_MAXLEN+1];
-  static int8_t tendname = -1; // tokenized end state name
+  struct S_endxr_parser *enp = &ctx->enp;
 
   if(c == '\0')
   { // reset parsing state
-    state = LIBXSVF_TAP_INIT;
-    endnamelen = 0;
-    tendname = -1;
+    enp->state = LIBXSVF_TAP_INIT;
+    enp->endnamelen = 0;
+    enp->tendname = -1;
     return 0;
   }
-  switch(state)
+  switch(enp->state)
   {
     case ENPS_INIT:
       if(c >= 'A' && c <= 'Z')
       {
-        if(endnamelen < END_NAME_MAXLEN)
-          endname[endnamelen++] = c;
+        if(enp->endnamelen < END_NAME_MAXLEN)
+          enp->endname[enp->endnamelen++] = c;
         else
         {
           // name too long, error
-          endname[endnamelen] = '\0'; // 0-terminate
-          state = ENPS_ERROR;
+          enp->endname[enp->endnamelen] = '\0'; // 0-terminate
+          enp->state = ENPS_ERROR;
         }
         break;
       }
       if(c == ' ' || c == ';')
       {
-        endname[endnamelen] = '\0'; // 0-terminate
-        tendname = search_name(endname, Tap_states);
-        if(tendname == LIBXSVF_TAP_IDLE
-        || tendname == LIBXSVF_TAP_RESET
-        || tendname == LIBXSVF_TAP_DRPAUSE
-        || tendname == LIBXSVF_TAP_IRPAUSE
+        enp->endname[enp->endnamelen] = '\0'; // 0-terminate
+        enp->tendname = search_name(enp->endname, &Tap_states_kw);
+        if(enp->tendname == LIBXSVF_TAP_IDLE
+        || enp->tendname == LIBXSVF_TAP_RESET
+        || enp->tendname == LIBXSVF_TAP_DRPAUSE
+        || enp->tendname == LIBXSVF_TAP_IRPAUSE
         )
         {
-          *endxr_s = tendname;
-          state = ENPS_COMPLETE;
+          *endxr_s = enp->tendname;
+          enp->state = ENPS_COMPLETE;
         }
         else
-          state = ENPS_ERROR;
-        if(tendname >= 0)
-          PRINTF("tendname '%s' %s", Tap_states[tendname], state == ENPS_ERROR ? "error" : "ok");
+          enp->state = ENPS_ERROR;
+        if(enp->tendname >= 0)
+          TRACE(ctx, TR_STATE, enp->tendname, enp->state == ENPS_ERROR, 0);
         break;
       }
-      state = ENPS_ERROR;
+      enp->state = ENPS_ERROR;
       break;
     default:
       break;
@@ -1185,72 +1587,78 @@ int8_t cmd_endxr(char c, uint8_t *endxr_s)
   return 0;
 }
 
-int8_t cmd_enddr(char c)
+int8_t cmd_enddr(struct S_svfparser *ctx, char c)
 {
-  return cmd_endxr(c, &(endxr_state[ENDX_ENDDR]));
+  return cmd_endxr(ctx, c, &(ctx->endxr_state[ENDX_ENDDR]));
 }
 
-int8_t cmd_endir(char c)
+int8_t cmd_endir(struct S_svfparser *ctx, char c)
 {
-  return cmd_endxr(c, &(endxr_state[ENDX_ENDIR]));
+  return cmd_endxr(ctx, c, &(ctx->endxr_state[ENDX_ENDIR]));
 }
 
 // walks the TAP over the list of states
-int8_t cmd_state(char c)
+int8_t cmd_state(struct S_svfparser *ctx, char c)
 {
-  static int8_t state = SWPS_INIT;
-  static int statenamelen = 0;
-  static char statename[LIBXSVF_TAP_NAME_MAXLEN+1];
-  static int8_t tstatename = -1; // tokenized state name
+  struct S_state_parser *swp = &ctx->swp;
 
   if(c == '\0')
   { // reset parsing state
-    state = SWPS_INIT;
-    statenamelen = 0;
-    tstatename = -1;
+    swp->state = SWPS_INIT;
+    swp->statenamelen = 0;
+    swp->tstatename = -1;
+    ctx->state_path_len = 0;
     return 0;
   }
-  switch(state)
+  switch(swp->state)
   {
     case SWPS_INIT:
-      if(c >= 'A' && c <= 'Z')
+      // names such as DREXIT1 end with a digit
+      if((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
       {
-        if(statenamelen < LIBXSVF_TAP_NAME_MAXLEN)
-          statename[statenamelen++] = c;
+        if(swp->statenamelen < LIBXSVF_TAP_NAME_MAXLEN)
+          swp->statename[swp->statenamelen++] = c;
         else
         {
           // name too long, error
-          statename[statenamelen] = '\0'; // 0-terminate
-          state = SWPS_ERROR;
+          swp->statename[swp->statenamelen] = '\0'; // 0-terminate
+          swp->state = SWPS_ERROR;
         }
         break;
       }
       if(c == ' ' || c == ';')
       {
-        statename[statenamelen] = '\0'; // 0-terminate
-        tstatename = search_name(statename, Tap_states);
-        if(tstatename >= 0)
-          PRINTF("tstatename '%s'", Tap_states[tstatename]);
+        swp->statename[swp->statenamelen] = '\0'; // 0-terminate
+        swp->tstatename = search_name(swp->statename, &Tap_states_kw);
+        if(swp->tstatename >= 0)
+          TRACE(ctx, TR_STATE, swp->tstatename, 0, 0);
         else
         {
-          state = SWPS_ERROR;
+          swp->state = SWPS_ERROR;
+          break;
+        }
+        if(ctx->state_path_len < STATE_PATH_MAX)
+          ctx->state_path[ctx->state_path_len++] = swp->tstatename;
+        else
+        {
+          swp->state = SWPS_ERROR;
           break;
         }
         if(c == ' ')
         {
-          state = SWPS_SPACE;
-          statenamelen = 0;
-          tstatename = -1;
+          swp->state = SWPS_SPACE;
+          swp->statenamelen = 0;
+          swp->tstatename = -1;
           break;
         }
         if(c == ';')
         {
-          state = SWPS_COMPLETE;
+          swp->state = SWPS_COMPLETE;
           break;
         }
         break;
       }
-      state = SWPS_ERROR;
+      swp->state = SWPS_ERROR;
       break;
     case SWPS_SPACE:
       if(c == ' ')
@@ -1259,22 +1667,23 @@ int8_t cmd_state(char c)
       }
       if(c == ';')
       {
-        state = SWPS_COMPLETE;
+        swp->state = SWPS_COMPLETE;
+        break;
       }
       if(c >= 'A' && c <= 'Z')
       {
-        if(statenamelen < LIBXSVF_TAP_NAME_MAXLEN)
-          statename[statenamelen++] = c;
+        if(swp->statenamelen < LIBXSVF_TAP_NAME_MAXLEN)
+          swp->statename[swp->statenamelen++] = c;
         else
         {
           // name too long, error
-          statename[statenamelen] = '\0'; // 0-terminate
-          state = SWPS_ERROR;
+          swp->statename[swp->statenamelen] = '\0'; // 0-terminate
+          swp->state = SWPS_ERROR;
         }
-        state = SWPS_INIT;
+        swp->state = SWPS_INIT;
         break;
       }
-      state = SWPS_ERROR;
+      swp->state = SWPS_ERROR;
       break;
     default:
       break;
@@ -1284,129 +1693,119 @@ int8_t cmd_state(char c)
 
 // transition between two states
 // with given clock count and timing
-int8_t cmd_runtest(char c)
-{
-  static int8_t state = RTPS_INIT;
-  static int wordlen = 0;
-  static char word[RUNTEST_NAME_MAXLEN+1];
-  static int8_t tstatename = -1; // tokenized state name
-  static int8_t trtword = -1; // tokenized runtest word
-  static int8_t trtword_prev = -1; // tokenized runtest word
-  static int8_t tendstatename = -1; // tokenized state name
-  static struct S_float mintime, maxtime;
+int8_t cmd_runtest(struct S_svfparser *ctx, char c)
+{
+  struct S_runtest_parser *rtp = &ctx->rtp;
   // static uint32_t run_count = 0;
   if(c == '\0')
   { // reset parsing state
-    state = RTPS_INIT;
-    wordlen = 0;
-    tstatename = -1;
-    trtword = -1;
-    trtword_prev = -1;
-    tendstatename = -1;
-    memset(&mintime, 0, sizeof(struct S_float));
-    memset(&maxtime, 0, sizeof(struct S_float));
+    rtp->state = RTPS_INIT;
+    rtp->wordlen = 0;
+    rtp->tstatename = -1;
+    rtp->trtword = -1;
+    rtp->trtword_prev = -1;
+    rtp->tendstatename = -1;
+    memset(&rtp->mintime, 0, sizeof(struct S_float));
+    memset(&rtp->maxtime, 0, sizeof(struct S_float));
+    ctx->runtest.end_state = -1;
+    ctx->runtest.run_count = 0;
+    ctx->runtest.min_us = 0;
     return 0;
   }
-  switch(state)
+  switch(rtp->state)
   {
     case RTPS_INIT:
       // state name doesn't start with T or S
       // so we can detect clock by its first letter
       if(c >= 'A' && c <= 'Z')
       {
-        wordlen = 0;
-        word[wordlen++] = c;
-        state = RTPS_WORD;
+        rtp->wordlen = 0;
+        rtp->word[rtp->wordlen++] = c;
+        rtp->state = RTPS_WORD;
         break;
       }
       if(c >= '0' && c <= '9')
       {
-        parse_float('\0');
-        parse_float(c);
-        state = RTPS_NUMBER;
+        parse_float(ctx, '\0');
+        parse_float(ctx, c);
+        rtp->state = RTPS_NUMBER;
         break;
       }
       if(c == ';')
       {
-        state = RTPS_COMPLETE;
+        rtp->state = RTPS_COMPLETE;
         break;
       }
-      state = RTPS_ERROR;
+      rtp->state = RTPS_ERROR;
       break;
     case RTPS_WORD:
       if(c >= 'A' && c <= 'Z')
       {
-        if(wordlen < RUNTEST_NAME_MAXLEN)
-          word[wordlen++] = c;
+        if(rtp->wordlen < RUNTEST_NAME_MAXLEN)
+          rtp->word[rtp->wordlen++] = c;
         else
         {
           // name too long, error
-          word[wordlen] = '\0'; // 0-terminate
-          state = RTPS_ERROR;
+          rtp->word[rtp->wordlen] = '\0'; // 0-terminate
+          rtp->state = RTPS_ERROR;
         }
         break;
       }
       if(c == ' ' || c == ';')
       {
-        word[wordlen] = '\0'; // 0-terminate
-        tstatename = search_name(word, Tap_states);
-        trtword = search_name(word, runtest_words);
-        if(tstatename < 0 && trtword < 0)
+        rtp->word[rtp->wordlen] = '\0'; // 0-terminate
+        rtp->tstatename = search_name(rtp->word, &Tap_states_kw);
+        rtp->trtword = search_name(rtp->word, &runtest_words_kw);
+        if(rtp->tstatename < 0 && rtp->trtword < 0)
         {
-          state = RTPS_ERROR;
+          rtp->state = RTPS_ERROR;
           break;
         }
         // there should be no common words
-        // in Tap_states and runtest_words,
+        // in Svf_tap_state_name and runtest_words,
         // therefore either tstatename or trtword
         // should match, not both
-        if(tstatename >= 0 && trtword >= 0)
+        if(rtp->tstatename >= 0 && rtp->trtword >= 0)
         {
-          printf("problem: double match tstatename and trtword '%s'", word);
-          state = RTPS_ERROR;
+          printf("problem: double match tstatename and trtword '%s'", rtp->word);
+          rtp->state = RTPS_ERROR;
           break;
         }
-        if(tstatename >= 0)
+        if(rtp->tstatename >= 0)
         {
-          if(trtword_prev == RT_WORD_ENDSTATE)
+          if(rtp->trtword_prev == RT_WORD_ENDSTATE)
           {
-            tendstatename = tstatename;
-            PRINTF("tendstatename '%s'", Tap_states[tendstatename]);
+            rtp->tendstatename = rtp->tstatename;
+            ctx->runtest.end_state = rtp->tendstatename;
+            TRACE(ctx, TR_STATE, rtp->tendstatename, 0, 0);
           }
           else
-            PRINTF("tstatename '%s'", Tap_states[tstatename]);
+          {
+            ctx->runtest.run_state = rtp->tstatename;
+            TRACE(ctx, TR_STATE, rtp->tstatename, 0, 0);
+          }
         }
-        if(trtword >= 0)
+        if(rtp->trtword >= 0)
         {
-          PRINTF("trtword '%s'", runtest_words[trtword]);
           // at runtest word SCK or TCK -> run count
           // SEC -> min/max time
-          if(trtword == RT_WORD_SCK || trtword == RT_WORD_TCK)
-          {
-            PRINTF("<-RUN COUNT");
-          }
-          if(trtword == RT_WORD_SEC)
+          if(rtp->trtword == RT_WORD_SCK || rtp->trtword == RT_WORD_TCK)
           {
-            if(trtword_prev == RT_WORD_MAXIMUM)
-            {
-              PRINTF("<-maxtime=%d.%dE%c%d ",
-                maxtime.number, maxtime.frac, maxtime.expsign > 0 ? '+' : '-', maxtime.exponent);
-            }
-            else
-            {
-              PRINTF("<-mintime=%d.%dE%c%d ",
-                mintime.number, mintime.frac, mintime.expsign > 0 ? '+' : '-', mintime.exponent);
-            }
+            // number before clock word is stored as mintime
+            ctx->runtest.run_count = rtp->mintime.number;
           }
+          // max time is not used
+          if(rtp->trtword == RT_WORD_SEC && rtp->trtword_prev != RT_WORD_MAXIMUM)
+            ctx->runtest.min_us = float_microseconds(&rtp->mintime);
         }
-        trtword_prev = trtword;
+        rtp->trtword_prev = rtp->trtword;
         if(c == ';')
-          state = RTPS_COMPLETE;
+          rtp->state = RTPS_COMPLETE;
         else
-          state = RTPS_INIT;
+          rtp->state = RTPS_INIT;
         break;
       }
-      state = RTPS_ERROR;
+      rtp->state = RTPS_ERROR;
       break;
     case RTPS_NUMBER:
       if( (c >= '0' && c <= '9')
@@ -1414,35 +1813,27 @@ int8_t cmd_runtest(char c)
         || c == '+' || c == '-'
         || c == 'E' )
       {
-        parse_float(c);
-        if(fl.state == FLPS_ERROR)
+        parse_float(ctx, c);
+        if(ctx->fl.state == FLPS_ERROR)
         {
-          PRINTF("float parse error");
-          state = RTPS_ERROR;
+          PRINTF("float parse error\n");
+          rtp->state = RTPS_ERROR;
         }
         break;
       }
       if(c == ' ' || c == ';')
       {
-        if(trtword_prev == RT_WORD_MAXIMUM)
-        {
-          PRINTF("MAX:");
-          memcpy(&maxtime, &fl, sizeof(struct S_float));
-        }
+        if(rtp->trtword_prev == RT_WORD_MAXIMUM)
+          memcpy(&rtp->maxtime, &ctx->fl, sizeof(struct S_float));
         else
-        {
-          PRINTF("MIN:");
-          memcpy(&mintime, &fl, sizeof(struct S_float));
-        }
-        PRINTF("FLOAT %d.%dE%c%d ",
-          fl.number, fl.frac, fl.expsign > 0 ? '+' : '-', fl.exponent);
+          memcpy(&rtp->mintime, &ctx->fl, sizeof(struct S_float));
         if(c == ';')
-          state = RTPS_COMPLETE;
+          rtp->state = RTPS_COMPLETE;
         else
-          state = RTPS_INIT;
+          rtp->state = RTPS_INIT;
         break;
       }
-      state = RTPS_ERROR;
+      rtp->state = RTPS_ERROR;
       break;
     default:
       break;
@@ -1451,9 +1842,13 @@ int8_t cmd_runtest(char c)
 }
 
 // struct to command service functions
+// service: called char by char
+// span: optional, called with the rest of the packet
+//       returns number of chars consumed, 0 to get them char by char
 struct S_cmd_service
 {
-  int8_t (*service)(char);
+  int8_t (*service)(struct S_svfparser *, char);
+  uint32_t (*span)(struct S_svfparser *, const uint8_t *, uint32_t);
 };
 
 struct S_cmd_service Cmd_service[] =
@@ -1461,16 +1856,16 @@ struct S_cmd_service Cmd_service[] =
   [CMD_ENDDR] = { cmd_enddr },
   [CMD_ENDIR] = { cmd_endir },
   [CMD_FREQUENCY] = { cmd_frequency },
-  [CMD_HDR] = { cmd_hdr },
-  [CMD_HIR] = { cmd_hir },
+  [CMD_HDR] = { cmd_hdr, cmd_hdr_span },
+  [CMD_HIR] = { cmd_hir, cmd_hir_span },
   [CMD_PIO] = { cmd_pio },
   [CMD_PIOMAP] = { NULL },
   [CMD_RUNTEST] = { cmd_runtest },
-  [CMD_SDR] = { cmd_sdr },
-  [CMD_SIR] = { cmd_sir },
+  [CMD_SDR] = { cmd_sdr, cmd_sdr_span },
+  [CMD_SIR] = { cmd_sir, cmd_sir_span },
   [CMD_STATE] = { cmd_state },
-  [CMD_TDR] = { cmd_tdr },
-  [CMD_TIR] = { cmd_tir },
+  [CMD_TDR] = { cmd_tdr, cmd_tdr_span },
+  [CMD_TIR] = { cmd_tir, cmd_tir_span },
   [CMD_TRST] = { NULL },
 };
 /* ******************* END COMMAND SERVICE FUNCTIONS ******************* */
@@ -1481,34 +1876,30 @@ return -1 command incomplete
         0 neutral (spaces, not in command)
         1 command complete
 */
-int8_t commandstate(char c)
+int8_t commandstate(struct S_svfparser *ctx, char c)
 {
-  static uint32_t cmdindex = 0;
-  static char cmdbuf[CMDS_MAX_CHARS+1];  // buffer command chars + null
-  static int8_t command = -1; // detected command
-  static uint8_t cdstate = CD_INIT; // first few chars of command detection state
-  static int8_t cxstate = -1; // command execution state
 
   if(c == '\0')
   {
-    cmdindex = 0;
-    command = -1;
-    cdstate = CD_INIT;
+    ctx->cmdindex = 0;
+    ctx->command = -1;
+    ctx->cdstate = CD_INIT;
+    ctx->exec_command = -1;
     return 0;
   }
 
-  switch(cdstate)
+  switch(ctx->cdstate)
   {
         case CD_INIT:
           // looking for non-space
           if(c != ' ')
           {
-            cmdbuf[0] = c;
-            cmdindex = 1;
-            command = -1;
-            Completed_command = CMD_NUM;
-            cxstate = -1;
-            cdstate = CD_START;
+            ctx->cmdbuf[0] = c;
+            ctx->cmdindex = 1;
+            ctx->command = -1;
+            ctx->completed_command = CMD_NUM;
+            ctx->cxstate = -1;
+            ctx->cdstate = CD_START;
           }
           return 0;
           break;
@@ -1516,41 +1907,43 @@ int8_t commandstate(char c)
           if(c == ' ')
           {
             // space found, search for the buffered command
-            cmdbuf[cmdindex] = '\0'; // 0-terminate string
-            command = search_name(cmdbuf, Commands);
-            if(command < 0)
-              cdstate = CD_ERROR;
+            ctx->cmdbuf[ctx->cmdindex] = '\0'; // 0-terminate string
+            ctx->command = search_name(ctx->cmdbuf, &Commands_kw);
+            if(ctx->command < 0)
+              ctx->cdstate = CD_ERROR;
             else
             {
-              PRINTF("<found %s>", Commands[command]);
+              TRACE(ctx, TR_COMMAND, ctx->command, ctx->line_count + 1, 0);
               // TODO reset previous buffered content
               // reset parser state of the command service function
-              if(Cmd_service[command].service)
-                Cmd_service[command].service('\0');
-              cdstate = CD_EXEC;
+              if(Cmd_service[ctx->command].service)
+                Cmd_service[ctx->command].service(ctx, '\0');
+              ctx->exec_command = ctx->command;
+              ctx->cdstate = CD_EXEC;
             }
             break;
           }
           // limited buffering
-          if(cmdindex < CMDS_MAX_CHARS)
+          if(ctx->cmdindex < CMDS_MAX_CHARS)
           {
-            cmdbuf[cmdindex] = c;
-            cmdindex++;
+            ctx->cmdbuf[ctx->cmdindex] = c;
+            ctx->cmdindex++;
           }
           break;
         case CD_EXEC:
           // executing
           // sanity check
-          if(command < 0 || command >= CMD_NUM)
+          if(ctx->command < 0 || ctx->command >= CMD_NUM)
             return -2; // strange, this should never happen
           // call selected command service function
-          if(Cmd_service[command].service)
-            cxstate = Cmd_service[command].service(c);
+          if(Cmd_service[ctx->command].service)
+            ctx->cxstate = Cmd_service[ctx->command].service(ctx, c);
           // semicolon to end command
           if(c == ';')
           {
-            cdstate = CD_INIT;
-            Completed_command = command;
+            ctx->cdstate = CD_INIT;
+            ctx->exec_command = -1;
+            ctx->completed_command = ctx->command;
             return 1; // command complete
           }
           break;
@@ -1562,25 +1955,104 @@ int8_t commandstate(char c)
   return -1; // command incomplete
 }
 
-void init_reversenibble()
+// span of text for the executing command
+// return value: number of chars consumed,
+// 0 if chars must be passed one by one to commandstate()
+uint32_t commandstate_span(struct S_svfparser *ctx, const uint8_t *s, uint32_t n)
 {
-  uint8_t i,j,v,r;     // input bits to be reversed
+  if(ctx->exec_command < 0 || Cmd_service[ctx->exec_command].span == NULL)
+    return 0;
+  return Cmd_service[ctx->exec_command].span(ctx, s, n);
+}
 
-  for (i = 0; i < 16; i++)
+// length of the run of blanks (space, tab, newline) at s,
+// newlines in the run are added to *newlines
+uint32_t blank_span(const uint8_t *s, uint32_t n, uint32_t *newlines)
+{
+  uint32_t j = 0;
+  #if defined(__SSE2__)
+  while(n - j >= 16)
   {
-    for (v = i, r = 0, j = 0; j < 4; j++)
-    {   
-      r <<= 1;
-      r |= v & 1;
-      v >>= 1;
+    __m128i c = _mm_loadu_si128((const __m128i *)(s + j));
+    uint32_t nl = _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8('\n')));
+    uint32_t blank = nl
+      | _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')))
+      | _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8('\t')));
+    if(blank != 0xFFFF)
+    {
+      uint32_t run = __builtin_ctz(~blank);
+      *newlines += __builtin_popcount(nl & ((1 << run) - 1));
+      return j + run;
     }
-    #if REVERSE_NIBBLE
-      ReverseNibble[i] = r;
-      // PRINTF("%1X - %1X\n", i, r);
-    #else
-      ReverseNibble[i] = i;
-    #endif
+    *newlines += __builtin_popcount(nl);
+    j += 16;
+  }
+  #endif
+  for(; j < n; j++)
+  {
+    if(s[j] == '\n')
+      (*newlines)++;
+    else if(s[j] != ' ' && s[j] != '\t')
+      break;
   }
+  return j;
+}
+
+void svf_init(struct S_svfparser *ctx)
+{
+  struct S_bitseq *bs[] = { &ctx->bs_hdr, &ctx->bs_hir, &ctx->bs_sdr, &ctx->bs_sir, &ctx->bs_tdr, &ctx->bs_tir };
+  memset(ctx, 0, sizeof(struct S_svfparser));
+  for(int j = 0; j < 6; j++)
+    for(int i = 0; i < BSF_NUM; i++)
+      bs[j]->digitindex[i] = -1;
+  ctx->bsp.tbfname = -1;
+  ctx->bsp.digitindex = -1;
+  ctx->endxr_state[ENDX_ENDDR] = LIBXSVF_TAP_IDLE;
+  ctx->endxr_state[ENDX_ENDIR] = LIBXSVF_TAP_IDLE;
+  ctx->runtest.run_state = LIBXSVF_TAP_IDLE;
+  ctx->runtest.end_state = -1;
+  ctx->command = -1;
+  ctx->cdstate = CD_INIT;
+  ctx->cxstate = -1;
+  ctx->exec_command = -1;
+  ctx->completed_command = CMD_NUM;
+  ctx->lstate = LS_SPACE;
+  ctx->span_ok = 1;
+  ctx->msb_first = jtag_msb_first();
+  ctx->verify.msb_first = ctx->msb_first;
+  ctx->verify.off = !jtag_tdo_valid();
+  ctx->max_transfer = jtag_max_transfer();
+  svftap_init(&ctx->tap, play_tms, ctx);
+}
+
+void svf_free(struct S_svfparser *ctx)
+{
+  struct S_bitseq *bs[] = { &ctx->bs_hdr, &ctx->bs_hir, &ctx->bs_sdr, &ctx->bs_sir, &ctx->bs_tdr, &ctx->bs_tir };
+  for(int j = 0; j < 6; j++)
+    for(int i = 0; i < BSF_NUM; i++)
+      bitseq_release(ctx, bs[j], i);
+  PRINTF("arena: %d chunks of %d bytes, high-water %d, %d heap calls\n",
+    ctx->arena.chunks_total, SVF_CHUNK_BYTES, ctx->arena.chunks_high, ctx->arena.heap_calls);
+  svfarena_free(&ctx->arena);
+  PRINTF("cache: value %d hits %d misses, scan %d hits %d misses\n",
+    ctx->cache.value_hits, ctx->cache.value_misses, ctx->cache.scan_hits, ctx->cache.scan_misses);
+  svfscan_free(&ctx->capture);
+  svfscan_free(&ctx->chunks);
+  free(ctx->jtag_seg);
+  ctx->jtag_seg = NULL;
+  ctx->jtag_seg_allocated = 0;
+  free(ctx->pack);
+  ctx->pack = NULL;
+  ctx->pack_allocated = 0;
+  if(ctx->verify.off)
+    PRINTF("verify: backend reads no TDO, not checked\n");
+  else if(ctx->verify.failures)
+    PRINTF("verify: %u of %u scans failed, first scan %u command %u line %u bit %u\n",
+      ctx->verify.failures, ctx->verify.scans, ctx->verify.first_scan, ctx->verify.first_command,
+      ctx->verify.first_line, ctx->verify.first_bit);
+  else
+    PRINTF("verify: %u scans ok\n", ctx->verify.scans);
+  svfverify_free(&ctx->verify);
 }
 
 // index = position in the stream (0 resets FSM)
@@ -1591,104 +2063,162 @@ void init_reversenibble()
 // 0 - no error, call me again when data available
 // 1 - finished OK
 // -1 - finished, error
-int8_t parse_svf_packet(uint8_t *packet, uint32_t index, uint32_t length, uint8_t final)
+int8_t parse_svf_packet(struct S_svfparser *ctx, uint8_t *packet, uint32_t index, uint32_t length, uint8_t final)
 {
-  PRINTF("index %d final %d\n", index, final);
-  static uint8_t lstate = LS_SPACE;
-  static uint32_t line_count = 0;
-  static uint8_t lbracket = 0;
-  static int8_t cmderr = 0;
+  TRACE(ctx, TR_PACKET, final, index, length);
+  // pipelined: shifts run in the driver thread, not here
+  uint64_t t_start = svfstats_now(), shift_ns = ctx->pipe ? 0 : ctx->stats.shift.ns;
+  ctx->stats.bytes += length;
+  PROFILE_START(ctx);
+  PROFILE_BYTES(ctx, STAGE_LEXER, length);
+  PROFILE_BYTES(ctx, STAGE_DISPATCH, length);
   if(index == 0)
   {
-    lstate = LS_SPACE;
-    line_count = 0;
-    lbracket = 0;
-    init_reversenibble();
-    jtag_open();
-    commandstate('\0');
+    ctx->lstate = LS_SPACE;
+    ctx->line_count = 0;
+    ctx->lbracket = 0;
+    ctx->span_ok = 1;
+    if(ctx->sink == NULL && ctx->pipe == NULL)
+      jtag_open();
+    commandstate(ctx, '\0');
   }
   uint32_t i;
   char c;
   for(i = 0; i < length; i++)
   {
+    // bulk path: comment text up to the newline,
+    // newline itself is processed below
+    if(ctx->lstate == LS_COMMENT)
+    {
+      uint8_t *newline = (uint8_t *)memchr(packet + i, '\n', length - i);
+      if(newline == NULL)
+        break; // comment continues in next packet
+      i = newline - packet;
+    }
+    // bulk path: more blanks after a blank
+    else if(ctx->lstate == LS_SPACE)
+    {
+      i += blank_span(packet + i, length - i, &ctx->line_count);
+      if(i >= length)
+        break;
+    }
+    // bulk path: text taken by the command as a span.
+    // declined span is offered again at next token
+    if(ctx->exec_command >= 0 && (ctx->lstate == LS_SPACE || (ctx->lstate == LS_TEXT && ctx->span_ok)))
+    {
+      uint32_t n;
+      {
+        PROFILE_ENTER(ctx, STAGE_DISPATCH);
+        n = commandstate_span(ctx, packet + i, length - i);
+        PROFILE_LEAVE(ctx);
+      }
+      if(n > 0)
+      {
+        ctx->lstate = LS_TEXT;
+        ctx->span_ok = 1;
+        i += n - 1;
+        continue;
+      }
+      ctx->span_ok = 0;
+    }
     c = packet[i];
     // ****** COMMENT REJECTION
     switch(c)
     {
       case '!':
-        lstate = LS_COMMENT;
+        ctx->lstate = LS_COMMENT;
         break;
       case '/':
-        if(lstate == LS_COMMENT)
+        if(ctx->lstate == LS_COMMENT)
           break;
-        if(lstate == LS_SLASH)
-          lstate = LS_COMMENT;
+        if(ctx->lstate == LS_SLASH)
+          ctx->lstate = LS_COMMENT;
         else
-          lstate = LS_SLASH;
+          ctx->lstate = LS_SLASH;
         break;
       case '\n':
         c = ' '; // rewrite as simple space
-        line_count++; // this is newline, similar as space
-        if(lstate == LS_COMMENT)
+        ctx->line_count++; // this is newline, similar as space
+        if(ctx->lstate == LS_COMMENT)
         {
-          lstate = LS_SPACE;
+          ctx->lstate = LS_SPACE;
           break;
         } // FALL THRU
       case ' ':
       case '\t':
         c = ' '; // rewrite as simple space
-        if(lstate == LS_COMMENT)
+        if(ctx->lstate == LS_COMMENT)
           break;
-        if(lstate == LS_SLASH)
+        if(ctx->lstate == LS_SLASH)
         {
           puts("?space after single '/'");
-          lstate = LS_SPACE;
+          ctx->lstate = LS_SPACE;
           break;
         }
-        if(lstate == LS_SPACE)
+        if(ctx->lstate == LS_SPACE)
         {
           // another space, do nothing
           break;
         }
         // this is first space probably after some some text.
         // check do we have now complete number or reserved word
-        lstate = LS_SPACE;
-        if(lbracket == 0)
+        ctx->lstate = LS_SPACE;
+        if(ctx->lbracket == 0)
         {
-          PRINTF("_");
-          cmderr = commandstate(c); // process the space
+          PROFILE_ENTER(ctx, STAGE_DISPATCH);
+          ctx->cmderr = commandstate(ctx, c); // process the space
+          PROFILE_LEAVE(ctx);
         }
         break;
       default:
-        if(lstate == LS_COMMENT)
+        if(ctx->lstate == LS_COMMENT)
           break;
         if(c == '(')
-          lbracket++;
+          ctx->lbracket++;
         if(c == ')')
-          lbracket--;
-        lstate = LS_TEXT;
+          ctx->lbracket--;
+        if(c == '(' || c == ')')
+          ctx->span_ok = 1;
+        ctx->lstate = LS_TEXT;
         break;
     }
-    if(lstate == LS_TEXT)
+    if(ctx->lstate == LS_TEXT)
     {
       // only active text appears here. comments and 
       // multiple spaces are filtered out
       c = toupper(c); // SVF is case insensitive
-      PRINTF("%c", c);
-      cmderr = commandstate(c);      
-      if(cmderr > 0)
       {
-        PRINTF("command %s complete\n", Commands[Completed_command]);
-        play_buffer();
+        PROFILE_ENTER(ctx, STAGE_DISPATCH);
+        ctx->cmderr = commandstate(ctx, c);
+        PROFILE_LEAVE(ctx);
+      }
+      if(ctx->cmderr > 0)
+      {
+        TRACE(ctx, TR_COMPLETE, ctx->completed_command, ctx->line_count + 1, 0);
+        PROFILE_ENTER(ctx, STAGE_SPLIT);
+        play_buffer(ctx);
+        PROFILE_LEAVE(ctx);
       }
     }
   }
-  if(final)
+  if(final && ctx->sink == NULL)
+    svftap_flush(&ctx->tap); // moves after the last scan
+  if(final && ctx->sink == NULL && ctx->pipe == NULL)
+  {
+    PROFILE_ENTER(ctx, STAGE_SPLIT);
+    svfverify_run(&ctx->verify); // deferred checks left
+    PROFILE_LEAVE(ctx);
     jtag_close();
-  if(cmderr < 0)
-    PRINTF("command incomplete\n");
-  if(cmderr > 0)
-    PRINTF("command complete\n");
-  PRINTF("line count %d\n", line_count);
+  }
+  PROFILE_STOP(ctx);
+  if(ctx->pipe == NULL)
+    t_start += ctx->stats.shift.ns - shift_ns;
+  ctx->stats.parse_ns += svfstats_now() - t_start;
+  TRACE(ctx, TR_PACKET_END, ctx->cmderr, ctx->line_count, 0);
+  if(final && ctx->cmderr < 0)
+  {
+    PRINTF("command incomplete or unknown at end of stream, line %u\n", ctx->line_count + 1);
+    return -1;
+  }
   return 0;
-} 
+}
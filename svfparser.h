@@ -1,10 +1,312 @@
 #ifndef SVFPARSER_H
 #define SVFPARSER_H
 #include <stdint.h>
+#include "jtaghw.h"
+#include "svfarena.h"
+#include "svfcache.h"
+#include "svftap.h"
+#include "svfscan.h"
+#include "svfverify.h"
+#include "svfstats.h"
+#include "svftrace.h"
 
-#define REVERSE_NIBBLE 0
-extern uint8_t ReverseNibble[]; // instantiated in svfparser.c
+// bit-reversed nibble, for backends shifting bit 7 first
+extern const uint8_t ReverseNibble[16]; // instantiated in svfparser.c
 
-int8_t parse_svf_packet(uint8_t *packet, uint32_t index, uint32_t length, uint8_t final);
+// bitfields are stored in arena chunks of this size
+#define SVF_CHUNK_BYTES SVF_ARENA_CHUNK_BYTES
+static_assert(SVF_CHUNK_BYTES >= SVFCACHE_MAX_BYTES, "a cached field must fit in its first chunk");
+
+// max number of states in one STATE command path
+#define STATE_PATH_MAX 32
+// maximal command length (buffering)
+#define CMDS_MAX_CHARS 15
+
+// enumerated (tokenized) reserved words
+enum
+{
+  CMD_ENDDR=0, // Specifies default end state for DR scan operations.
+  CMD_ENDIR, // Specifies default end state for IR scan operations.
+  CMD_FREQUENCY, // Specifies maximum test clock frequency for IEEE 1149.1 bus operations.
+  CMD_HDR, // (Header Data Register) Specifies a header pattern that is prepended to the beginning of subsequent DR scan operations.
+  CMD_HIR, // (Header Instruction Register) Specifies a header pattern that is prepended to the beginning of subsequent IR scan operations.
+  CMD_PIO, // (Parallel Input/Output) Specifies a parallel test pattern.
+  CMD_PIOMAP, // (Parallel Input/Output Map) Maps PIO column positions to a logical pin.
+  CMD_RUNTEST, // Forces the IEEE 1149.1 bus to a run state for a specified number of clocks or a specified time period.
+  CMD_SDR, // (Scan Data Register) Performs an IEEE 1149.1 Data Register scan.
+  CMD_SIR, // (Scan Instruction Register) Performs an IEEE 1149.1 Instruction Register scan.
+  CMD_STATE, // Forces the IEEE 1149.1 bus to a specified stable state.
+  CMD_TDR, // (Trailer Data Register) Specifies a trailer pattern that is appended to the end of subsequent DR scan operations.
+  CMD_TIR, // (Trailer Instruction Register) Specifies a trailer pattern that is appended to the end of subsequent IR scan operations.
+  CMD_TRST, // (Test ReSeT) Controls the optional Test Reset line.
+  CMD_NUM // LAST: represents number of reserved words
+};
+
+// TAP states enumerated/tokenized
+enum libxsvf_tap_state
+{
+  /* Special States */
+  LIBXSVF_TAP_INIT = 0,
+  LIBXSVF_TAP_RESET = 1,
+  LIBXSVF_TAP_IDLE = 2,
+  /* DR States */
+  LIBXSVF_TAP_DRSELECT = 3,
+  LIBXSVF_TAP_DRCAPTURE = 4,
+  LIBXSVF_TAP_DRSHIFT = 5,
+  LIBXSVF_TAP_DREXIT1 = 6,
+  LIBXSVF_TAP_DRPAUSE = 7,
+  LIBXSVF_TAP_DREXIT2 = 8,
+  LIBXSVF_TAP_DRUPDATE = 9,
+  /* IR States */
+  LIBXSVF_TAP_IRSELECT = 10,
+  LIBXSVF_TAP_IRCAPTURE = 11,
+  LIBXSVF_TAP_IRSHIFT = 12,
+  LIBXSVF_TAP_IREXIT1 = 13,
+  LIBXSVF_TAP_IRPAUSE = 14,
+  LIBXSVF_TAP_IREXIT2 = 15,
+  LIBXSVF_TAP_IRUPDATE = 16,
+  /* numbef of them */
+  LIBXSVF_TAP_NUM = 17,
+};
+
+// names of the reserved words by token, NULL terminated,
+// defined with the parser, also used by stats and trace
+extern const char *const Svf_command_name[CMD_NUM+1];
+extern const char *const Svf_tap_state_name[LIBXSVF_TAP_NUM+1];
+
+// endstate name DRCAPTURE is longest: 9 chars
+enum libxsvf_tap_name_max_len
+{
+  LIBXSVF_TAP_NAME_MAXLEN = 9
+};
+
+enum bit_sequence_field
+{
+  BSF_TDO = 0,
+  BSF_TDI,
+  BSF_MASK,
+  BSF_SMASK,
+  BSF_NUM
+};
+
+extern const char *const Svf_field_name[BSF_NUM+1];
+
+// bitfield name "SMASK" is longest: 5 chars
+enum bitfield_name_max_len
+{
+  BF_NAME_MAXLEN = 5
+};
+
+enum endxr_state_choice
+{
+  ENDX_ENDDR = 0,
+  ENDX_ENDIR,
+  ENDX_NUM
+};
+
+// endstate name IRPAUSE is longest: 7 chars
+enum end_name_max_len
+{
+  END_NAME_MAXLEN = 7
+};
+
+// max name length for all runtest names
+enum runtest_name_max_len
+{
+  RUNTEST_NAME_MAXLEN = 9
+};
+
+// bit sequence struct common for
+// HDR,HIR,SDR,SIR,TDR,TIR
+struct S_bitseq
+{
+  uint32_t length;
+  uint32_t length_prev[BSF_NUM]; // lengths of each bitfield of previous SVF command
+  int32_t digitindex[BSF_NUM]; // insertion digit (nibble) index running from 2*allocated-1 downto 0. -1 if no space left.
+  uint32_t allocated[BSF_NUM]; // how many bytes are usable in field[]
+  uint8_t **field[BSF_NUM]; // chunk pointers of tdo, tdi, mask, smask
+  uint32_t chunks[BSF_NUM]; // number of chunks in field[]
+};
+
+struct S_float
+{
+  int number, frac, fracdigits, expsign, exponent;
+  int8_t state;
+};
+
+// parsing state common for all bit sequence commands
+struct S_bitseq_parser
+{
+  int8_t state;
+  int bfnamelen;
+  char bfname[BF_NAME_MAXLEN+1];
+  int8_t tbfname; // tokenized bitfield name
+  int32_t digitindex; // countdown hex digits of the bitfield
+};
+
+// ENDDR, ENDIR parsing state
+struct S_endxr_parser
+{
+  int8_t state;
+  int endnamelen;
+  char endname[END_NAME_MAXLEN+1];
+  int8_t tendname; // tokenized end state name
+};
+
+// STATE parsing state
+struct S_state_parser
+{
+  int8_t state;
+  int statenamelen;
+  char statename[LIBXSVF_TAP_NAME_MAXLEN+1];
+  int8_t tstatename; // tokenized state name
+};
+
+// RUNTEST parsing state
+struct S_runtest_parser
+{
+  int8_t state;
+  int wordlen;
+  char word[RUNTEST_NAME_MAXLEN+1];
+  int8_t tstatename; // tokenized state name
+  int8_t trtword; // tokenized runtest word
+  int8_t trtword_prev; // tokenized runtest word
+  int8_t tendstatename; // tokenized state name
+  struct S_float mintime, maxtime;
+};
+
+// parameters of the last RUNTEST command
+struct S_runtest
+{
+  uint8_t run_state; // sticky between RUNTEST commands
+  int8_t end_state; // -1: same as run_state
+  uint32_t run_count; // number of TCK or SCK clocks
+  uint32_t min_us; // minimum time in microseconds
+};
+
+// receiver of completed commands, alternative to bitbanging.
+// bit sequences are packed in shift order: first bit shifted
+// is bit 0 of byte 0 (or bit 7 when msb_first),
+// fields not present in the command are NULL
+struct S_svf_sink
+{
+  void (*scan)(void *user, uint8_t ir, uint32_t length, uint8_t *tdi, uint8_t *tdo, uint8_t *mask, uint8_t endstate);
+  void (*state)(void *user, uint8_t *path, uint8_t n);
+  void (*runtest)(void *user, uint8_t runstate, uint32_t count, uint32_t min_us, uint8_t endstate);
+  void *user; // passed to the functions above
+};
+
+struct S_svfpipe;
+
+// parser stages timed when built with SVF_PROFILE (svfbench)
+enum svf_stage
+{
+  STAGE_LEXER = 0, // comments, blanks, tokens: all time not in a stage below
+  STAGE_DISPATCH, // command state machines
+  STAGE_HEX, // bulk hex decode of bitfield values
+  STAGE_SPLIT, // scan descriptors, TDO packing and checks, TAP moves
+  STAGE_BACKEND, // jtag_tdi_tdo(), jtag_tms() or queueing for the driver
+  STAGE_NUM
+};
+
+// time of each stage, exclusive of the stages it calls
+struct S_svfprofile
+{
+  uint64_t ticks[STAGE_NUM]; // CPU timestamp counter, else nanoseconds
+  uint64_t bytes[STAGE_NUM]; // input, hex digits or scan bytes gone through
+  uint64_t since; // tick of the last stage switch
+  uint8_t stage; // stage being timed
+};
+
+// always-on counters, see svfstats.h
+struct S_svfstats
+{
+  uint64_t bytes; // input bytes lexed
+  uint32_t commands[CMD_NUM]; // completed commands of each type
+  uint32_t scans[2]; // SDR [0], SIR [1] commands
+  uint64_t scan_bits[2]; // bits of them, with header and trailer
+  uint32_t reallocs; // heap growth of parser and pipeline buffers
+  uint32_t field_peak; // high-water bytes of bitfield chunks
+  uint32_t value_hits, value_misses; // value cache lookups
+  uint32_t scan_hits, scan_misses; // scan cache lookups
+  uint64_t parse_ns; // in parse_svf_packet(), shifting excluded
+  struct S_svflatency shift; // jtag_tdi_tdo() of each scan
+};
+
+// complete parser state, one per SVF stream.
+// different streams can be parsed in parallel
+// threads, each with its own context
+struct S_svfparser
+{
+  // bit order of all bitfields, from the backend: 0 - bit 0
+  // of each byte is shifted first, 1 - bit 7 (bytes bit-reversed)
+  uint8_t msb_first;
+  // max bytes of one backend transfer, 0 if none, from
+  // the backend: longer scans are shifted in chunks
+  uint32_t max_transfer;
+  // lexer
+  uint8_t lstate;
+  uint32_t line_count;
+  uint8_t lbracket;
+  int8_t cmderr;
+  uint8_t span_ok; // offer text spans to the command
+  // command detection
+  uint32_t cmdindex;
+  char cmdbuf[CMDS_MAX_CHARS+1]; // buffer command chars + null
+  int8_t command; // detected command
+  uint8_t cdstate; // first few chars of command detection state
+  int8_t cxstate; // command execution state
+  int8_t exec_command; // command being executed, -1 if none
+  int completed_command; // completed command
+  // HDR,HIR,SDR,SIR,TDR,TIR
+  struct S_bitseq_parser bsp;
+  struct S_bitseq bs_hdr, bs_hir, bs_sdr, bs_sir, bs_tdr, bs_tir;
+  // FREQUENCY
+  struct S_float fl;
+  int8_t fqstate;
+  // ENDDR, ENDIR
+  struct S_endxr_parser enp;
+  uint8_t endxr_state[ENDX_NUM];
+  // STATE, states in walking order
+  struct S_state_parser swp;
+  uint8_t state_path[STATE_PATH_MAX];
+  uint8_t state_path_len;
+  // RUNTEST
+  struct S_runtest_parser rtp;
+  struct S_runtest runtest;
+  // output
+  struct S_jtaghw jtag_tdi;
+  struct S_jtaghw *jtag_seg; // more tdi segments chained to jtag_tdi
+  uint32_t jtag_seg_allocated;
+  uint32_t jtag_seg_used; // taken for the current scan
+  struct S_svfscan_buf capture; // TDO of the scan being shifted
+  struct S_svfscan_buf chunks; // chunk descriptors of the scan being shifted
+  struct S_svfarena arena; // bitfield chunks
+  struct S_svfcache cache; // decoded and split short scans
+  struct S_svftap tap; // TAP state and pending TMS moves
+  struct S_svf_sink *sink; // NULL: completed commands are played to jtag hardware
+  struct S_svfpipe *pipe; // NULL: scans are shifted before parsing continues
+  uint8_t *pack; // packed bit sequences for the sink and TDO checks
+  uint32_t pack_allocated;
+  uint32_t commands; // commands played, from 1
+  uint32_t scans; // scans played, numbers TDO checks
+  struct S_svfverify verify; // TDO check results
+  struct S_svfprofile profile; // stage times, SVF_PROFILE builds only
+  struct S_svfstats stats; // counters, always on
+  #if SVF_TRACE
+  struct S_svftrace trace; // last parser events
+  #endif
+};
+
+// initialize context before first packet
+void svf_init(struct S_svfparser *ctx);
+// free memory allocated by the parser
+void svf_free(struct S_svfparser *ctx);
+
+// parse next packet of the stream, final: no more packets
+// return value:
+// 0 - ok
+// -1 - final packet: stream ends in an incomplete or unknown command
+int8_t parse_svf_packet(struct S_svfparser *ctx, uint8_t *packet, uint32_t index, uint32_t length, uint8_t final);
 
 #endif
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "svfpipe.h"
+
+#ifndef DBG_PRINT
+#define DBG_PRINT 1
+#endif
+#if DBG_PRINT
+#define PRINTF(f_, ...) printf((f_), ##__VA_ARGS__)
+#else
+#define PRINTF(f_, ...)
+#endif
+
+// driver can go on: ring not empty or closed
+static uint8_t svfpipe_filled(struct S_svfpipe *pipe)
+{
+  return __atomic_load_n(&pipe->tail, __ATOMIC_RELAXED) != __atomic_load_n(&pipe->head, __ATOMIC_ACQUIRE)
+    || __atomic_load_n(&pipe->closing, __ATOMIC_ACQUIRE);
+}
+
+// parser can go on: ring not full
+static uint8_t svfpipe_drained(struct S_svfpipe *pipe)
+{
+  return __atomic_load_n(&pipe->head, __ATOMIC_RELAXED) - __atomic_load_n(&pipe->tail, __ATOMIC_ACQUIRE) < SVFPIPE_DEPTH;
+}
+
+// yield a few times, then sleep on cond until ready
+static void svfpipe_wait(struct S_svfpipe *pipe, uint8_t (*ready)(struct S_svfpipe *),
+  uint8_t *waits, pthread_cond_t *cond)
+{
+  for(int spin = 0; spin < SVFPIPE_SPIN; spin++)
+  {
+    if(ready(pipe))
+      return;
+    sched_yield();
+  }
+  pthread_mutex_lock(&pipe->lock);
+  __atomic_store_n(waits, 1, __ATOMIC_RELAXED);
+  // the other side sees waits or we see its head/tail
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  while(!ready(pipe))
+    pthread_cond_wait(cond, &pipe->lock);
+  __atomic_store_n(waits, 0, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&pipe->lock);
+}
+
+// after moving head or tail: wake the other side if it sleeps
+static void svfpipe_wake(struct S_svfpipe *pipe, uint8_t *waits, pthread_cond_t *cond)
+{
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if(!__atomic_load_n(waits, __ATOMIC_RELAXED))
+    return;
+  pthread_mutex_lock(&pipe->lock);
+  pthread_cond_signal(cond);
+  pthread_mutex_unlock(&pipe->lock);
+}
+
+// driver is done with the slot at tail
+static void svfpipe_release(struct S_svfpipe *pipe, uint32_t tail)
+{
+  __atomic_store_n(&pipe->tail, tail + 1, __ATOMIC_RELEASE);
+  svfpipe_wake(pipe, &pipe->parser_waits, &pipe->drained);
+}
+
+// parser filled the slot at head
+static void svfpipe_publish(struct S_svfpipe *pipe)
+{
+  __atomic_store_n(&pipe->head, pipe->head + 1, __ATOMIC_RELEASE);
+  svfpipe_wake(pipe, &pipe->driver_waits, &pipe->filled);
+}
+
+// consumer: shifts queued scans until the parser closes the ring
+static void *svfpipe_driver(void *arg)
+{
+  struct S_svfpipe *pipe = (struct S_svfpipe *)arg;
+  for(;;)
+  {
+    uint32_t tail = pipe->tail;
+    if(tail == __atomic_load_n(&pipe->head, __ATOMIC_ACQUIRE))
+    {
+      // head is published before closing, recheck it after
+      if(__atomic_load_n(&pipe->closing, __ATOMIC_ACQUIRE)
+      && tail == __atomic_load_n(&pipe->head, __ATOMIC_ACQUIRE))
+      {
+        svfverify_run(pipe->verify); // deferred checks left
+        break;
+      }
+      svfpipe_wait(pipe, svfpipe_filled, &pipe->driver_waits, &pipe->filled);
+      continue;
+    }
+    struct S_svfpipe_slot *slot = &pipe->slot[tail & (SVFPIPE_DEPTH-1)];
+    if(slot->tms_bits || slot->runtest)
+    {
+      if(slot->runtest)
+        jtag_runtest(slot->run_state, slot->run_clocks, slot->run_us);
+      else
+        jtag_tms(slot->scan.buf, slot->tms_bits);
+      svfpipe_release(pipe, tail);
+      continue;
+    }
+    // deferred: expected bits move on from the slot to the check queue
+    uint8_t check = slot->check.length > 0;
+    uint8_t verify = check && !pipe->verify->off;
+    if(check)
+      jtag_expect(slot->check.tdo, slot->check.mask, slot->check.length);
+    else
+      jtag_expect(NULL, NULL, 0);
+    struct S_jtaghw *tdo = verify && pipe->verify->deferred
+      ? svfverify_defer(pipe->verify, slot->tdi, &slot->check) : svfscan_capture(&pipe->capture, slot->tdi);
+    uint64_t t = svfstats_now();
+    if(tdo != NULL && svfscan_shift(&pipe->chunks, slot->tdi, tdo, pipe->max_transfer) > 0)
+    {
+      svfstats_latency(pipe->latency, svfstats_now() - t);
+      if(verify && !pipe->verify->deferred)
+        svfverify_scan(pipe->verify, tdo, &slot->check);
+    }
+    else
+      PRINTF("Memory Allocation Failed\n");
+    // slot may be refilled from now on
+    svfpipe_release(pipe, tail);
+  }
+  return NULL;
+}
+
+int svfpipe_start(struct S_svfpipe *pipe, struct S_svfverify *verify, struct S_svflatency *latency, uint32_t *reallocs)
+{
+  memset(pipe, 0, sizeof(struct S_svfpipe));
+  pipe->verify = verify;
+  pipe->latency = latency;
+  pipe->reallocs = reallocs;
+  pipe->max_transfer = jtag_max_transfer();
+  pthread_mutex_init(&pipe->lock, NULL);
+  pthread_cond_init(&pipe->filled, NULL);
+  pthread_cond_init(&pipe->drained, NULL);
+  jtag_open();
+  if(pthread_create(&pipe->driver, NULL, svfpipe_driver, pipe) != 0)
+  {
+    PRINTF("can't start driver thread\n");
+    jtag_close();
+    pthread_mutex_destroy(&pipe->lock);
+    pthread_cond_destroy(&pipe->filled);
+    pthread_cond_destroy(&pipe->drained);
+    return -1;
+  }
+  return 0;
+}
+
+// wait until driver frees a slot (backpressure)
+static struct S_svfpipe_slot *svfpipe_slot(struct S_svfpipe *pipe)
+{
+  if(!svfpipe_drained(pipe))
+    svfpipe_wait(pipe, svfpipe_drained, &pipe->parser_waits, &pipe->drained);
+  return &pipe->slot[pipe->head & (SVFPIPE_DEPTH-1)];
+}
+
+int8_t svfpipe_push(struct S_svfpipe *pipe, struct S_jtaghw *tdi, struct S_svfcheck *check)
+{
+  struct S_svfpipe_slot *slot = svfpipe_slot(pipe);
+  slot->tdi = svfscan_copy(&slot->scan, tdi);
+  if(slot->tdi == NULL)
+  {
+    PRINTF("Memory Allocation Failed\n");
+    return -1;
+  }
+  slot->tms_bits = 0;
+  slot->runtest = 0;
+  slot->check.length = 0;
+  if(check != NULL)
+  {
+    // expected bits are overwritten by the next command
+    uint32_t bytes = (check->length+7)/8;
+    if(svfscan_reserve(&slot->expect, 2*bytes, 0) < 0)
+    {
+      PRINTF("Memory Allocation Failed\n");
+      return -1;
+    }
+    memcpy(slot->expect.buf, check->tdo, bytes);
+    memcpy(slot->expect.buf + bytes, check->mask, bytes);
+    slot->check = *check;
+    slot->check.tdo = slot->expect.buf;
+    slot->check.mask = slot->expect.buf + bytes;
+  }
+  svfpipe_publish(pipe);
+  return 0;
+}
+
+int8_t svfpipe_push_tms(struct S_svfpipe *pipe, uint8_t *tms, uint32_t bits)
+{
+  struct S_svfpipe_slot *slot = svfpipe_slot(pipe);
+  if(svfscan_reserve(&slot->scan, (bits+7)/8, 0) < 0)
+  {
+    PRINTF("Memory Allocation Failed\n");
+    return -1;
+  }
+  memcpy(slot->scan.buf, tms, (bits+7)/8);
+  slot->tms_bits = bits;
+  slot->runtest = 0;
+  svfpipe_publish(pipe);
+  return 0;
+}
+
+void svfpipe_push_runtest(struct S_svfpipe *pipe, uint8_t state, uint32_t clocks, uint32_t min_us)
+{
+  struct S_svfpipe_slot *slot = svfpipe_slot(pipe);
+  slot->tms_bits = 0;
+  slot->runtest = 1;
+  slot->run_state = state;
+  slot->run_clocks = clocks;
+  slot->run_us = min_us;
+  svfpipe_publish(pipe);
+}
+
+void svfpipe_stop(struct S_svfpipe *pipe)
+{
+  __atomic_store_n(&pipe->closing, 1, __ATOMIC_RELEASE);
+  svfpipe_wake(pipe, &pipe->driver_waits, &pipe->filled);
+  pthread_join(pipe->driver, NULL);
+  jtag_close();
+  pthread_mutex_destroy(&pipe->lock);
+  pthread_cond_destroy(&pipe->filled);
+  pthread_cond_destroy(&pipe->drained);
+  *pipe->reallocs += pipe->capture.grows + pipe->chunks.grows;
+  for(int i = 0; i < SVFPIPE_DEPTH; i++)
+  {
+    *pipe->reallocs += pipe->slot[i].scan.grows + pipe->slot[i].expect.grows;
+    svfscan_free(&pipe->slot[i].scan);
+    svfscan_free(&pipe->slot[i].expect);
+  }
+  svfscan_free(&pipe->capture);
+  svfscan_free(&pipe->chunks);
+  memset(pipe, 0, sizeof(struct S_svfpipe));
+}
@@ -0,0 +1,85 @@
+#ifndef SVFPIPE_H
+#define SVFPIPE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "jtaghw.h"
+#include "svfscan.h"
+#include "svfverify.h"
+#include "svfstats.h"
+
+/*
+pipelined scan execution: parser pushes completed scans
+and TMS bursts
+into a bounded single-producer/single-consumer ring and
+a driver thread shifts them to jtag hardware.
+
+each slot owns its buffer, reused (grown) from scan to scan.
+when the ring is full the parser waits for the driver
+(backpressure), so memory is bounded by
+SVFPIPE_DEPTH * largest scan. a side that has to wait
+yields a few times, then sleeps on a condition variable
+until the other side moves head or tail.
+
+expected TDO and MASK are copied into the slot with the
+scan, the driver checks the captured TDO after shifting
+or queues the check in deferred mode.
+*/
+
+// number of slots, must be power of 2
+#define SVFPIPE_DEPTH 16
+// yields before a waiting side goes to sleep
+#define SVFPIPE_SPIN 16
+
+struct S_svfpipe_slot
+{
+  struct S_svfscan_buf scan; // owned copy of the scan bits
+  struct S_jtaghw *tdi; // tdi segment chain in scan
+  uint32_t tms_bits; // not 0: slot is a TMS burst in scan.buf, no scan
+  uint8_t runtest; // not 0: slot is a RUNTEST, no scan
+  uint8_t run_state;
+  uint32_t run_clocks, run_us;
+  struct S_svfscan_buf expect; // owned copy of expected TDO and MASK
+  struct S_svfcheck check; // points into expect, check.length 0: no check
+};
+
+struct S_svfpipe
+{
+  struct S_svfpipe_slot slot[SVFPIPE_DEPTH];
+  uint32_t head; // next slot to fill, written only by parser
+  uint32_t tail; // next slot to shift, written only by driver
+  uint8_t closing; // set by parser when no more scans come
+  pthread_mutex_t lock; // for sleeping on filled and drained
+  pthread_cond_t filled; // driver sleeps here while the ring is empty
+  pthread_cond_t drained; // parser sleeps here while the ring is full
+  uint8_t driver_waits, parser_waits; // 1: side sleeps or is about to
+  pthread_t driver;
+  struct S_svfscan_buf capture; // driver's TDO buffer
+  struct S_svfscan_buf chunks; // driver's chunk descriptors
+  uint32_t max_transfer; // backend transfer limit, 0 if none
+  struct S_svfverify *verify; // TDO check results, written by driver
+  struct S_svflatency *latency; // shift times, written by driver
+  uint32_t *reallocs; // buffer grows added to it on stop
+};
+
+// open jtag hardware and start the driver thread,
+// which records TDO checks to verify and shift times to latency.
+// grows of the ring buffers are added to *reallocs on stop
+int svfpipe_start(struct S_svfpipe *pipe, struct S_svfverify *verify, struct S_svflatency *latency, uint32_t *reallocs);
+// copy scan and its expected TDO (check, NULL if none)
+// into the ring, waits while the ring is full
+// return value:
+// 0 - queued
+// -1 - memory allocation failed, scan dropped
+int8_t svfpipe_push(struct S_svfpipe *pipe, struct S_jtaghw *tdi, struct S_svfcheck *check);
+// copy TMS burst into the ring, kept in order with the scans
+// return value:
+// 0 - queued
+// -1 - memory allocation failed, burst dropped
+int8_t svfpipe_push_tms(struct S_svfpipe *pipe, uint8_t *tms, uint32_t bits);
+// queue RUNTEST in state, kept in order with the scans
+void svfpipe_push_runtest(struct S_svfpipe *pipe, uint8_t state, uint32_t clocks, uint32_t min_us);
+// shift remaining scans, stop the driver, close jtag hardware
+void svfpipe_stop(struct S_svfpipe *pipe);
+
+#endif
@@ -0,0 +1,412 @@
+#include <stdlib.h>
+#include <string.h>
+#include "svfparser.h" // ReverseNibble
+#include "svfscan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+struct S_fill_pages
+{
+  uint8_t page[2][SVFSCAN_FILL_BYTES];
+};
+
+constexpr struct S_fill_pages fill_pages()
+{
+  struct S_fill_pages f = {};
+  for(int j = 0; j < SVFSCAN_FILL_BYTES; j++)
+    f.page[1][j] = 0xFF;
+  return f;
+}
+
+// read-only, never written by backends (TDO goes to capture)
+static constexpr struct S_fill_pages Fill = fill_pages();
+
+uint8_t *svfscan_fill(uint8_t pad)
+{
+  return (uint8_t *)Fill.page[pad != 0];
+}
+
+// bytes needed for the bits of the segment chain,
+// number of segments to *segs. with own == 0 also
+// the bytes of fill segments are counted
+static uint32_t scan_bytes(struct S_jtaghw *hw, uint32_t *segs, uint8_t own)
+{
+  uint32_t bytes = 0;
+  for(*segs = 0; hw != NULL; hw = hw->next, (*segs)++)
+    if(!(own && hw->fill))
+      bytes += (hw->header_bits ? 1 : 0) + hw->data_bytes + (hw->trailer_bits ? 1 : 0);
+  return bytes;
+}
+
+int8_t svfscan_reserve(struct S_svfscan_buf *b, uint32_t bytes, uint32_t segs)
+{
+  if(bytes > b->allocated)
+  {
+    uint8_t *buf = (uint8_t *)realloc(b->buf, bytes);
+    if(buf == NULL)
+      return -1;
+    b->buf = buf;
+    b->allocated = bytes;
+    b->grows++;
+  }
+  if(segs > b->seg_allocated)
+  {
+    struct S_jtaghw *seg = (struct S_jtaghw *)realloc(b->seg, segs * sizeof(struct S_jtaghw));
+    if(seg == NULL)
+      return -1;
+    b->seg = seg;
+    b->seg_allocated = segs;
+    b->grows++;
+  }
+  return 0;
+}
+
+// describe mem as chain dst[] with the same segments and
+// header/data/trailer split as hw. copy: copy the bits,
+// fill segments keep pointing to the shared page.
+// capture: fresh memory for every segment
+static void scan_layout(struct S_jtaghw *dst, struct S_jtaghw *hw, uint8_t *mem, uint8_t copy)
+{
+  for(; hw != NULL; hw = hw->next, dst++)
+  {
+    *dst = *hw;
+    dst->next = hw->next != NULL ? dst + 1 : NULL;
+    if(copy && hw->fill)
+      continue;
+    dst->fill = 0;
+    if(hw->header_bits)
+    {
+      if(copy)
+        *mem = hw->header[0];
+      dst->header = mem++;
+    }
+    if(hw->data_bytes)
+    {
+      if(copy)
+        memcpy(mem, hw->data, hw->data_bytes);
+      dst->data = mem;
+      mem += hw->data_bytes;
+    }
+    if(hw->trailer_bits)
+    {
+      if(copy)
+        *mem = hw->trailer[0];
+      dst->trailer = mem++;
+    }
+  }
+}
+
+struct S_jtaghw *svfscan_copy(struct S_svfscan_buf *b, struct S_jtaghw *tdi)
+{
+  uint32_t segs, bytes = scan_bytes(tdi, &segs, 1);
+  if(svfscan_reserve(b, bytes, segs) < 0)
+    return NULL;
+  scan_layout(b->seg, tdi, b->buf, 1);
+  return b->seg;
+}
+
+struct S_jtaghw *svfscan_capture(struct S_svfscan_buf *b, struct S_jtaghw *tdi)
+{
+  uint32_t segs, bytes = scan_bytes(tdi, &segs, 0);
+  if(svfscan_reserve(b, bytes, segs) < 0)
+    return NULL;
+  scan_layout(b->seg, tdi, b->buf, 0);
+  return b->seg;
+}
+
+void svfscan_free(struct S_svfscan_buf *b)
+{
+  free(b->buf);
+  free(b->seg);
+  memset(b, 0, sizeof(struct S_svfscan_buf));
+}
+
+template<uint8_t Msb>
+static void bits_merge(uint8_t *dst, uint32_t at, const uint8_t *src, uint32_t n)
+{
+  uint32_t j, bytes = (n+7)/8, end = (at+n+7)/8;
+  uint8_t s = at & 7;
+  dst += at/8;
+  end -= at/8;
+  if(s == 0)
+  {
+    // byte aligned: plain copy, dst bits are 0
+    memcpy(dst, src, bytes);
+    return;
+  }
+  for(j = 0; j < bytes; j++)
+  {
+    if(Msb)
+    {
+      dst[j] |= src[j] >> s;
+      if(j+1 < end)
+        dst[j+1] |= src[j] << (8-s);
+    }
+    else
+    {
+      dst[j] |= src[j] << s;
+      if(j+1 < end)
+        dst[j+1] |= src[j] >> (8-s);
+    }
+  }
+}
+
+void svfscan_bits_merge(uint8_t *dst, uint32_t at, const uint8_t *src, uint32_t n, uint8_t msb_first)
+{
+  if(msb_first)
+    bits_merge<1>(dst, at, src, n);
+  else
+    bits_merge<0>(dst, at, src, n);
+}
+
+template<uint8_t Msb>
+static void bits_extract(uint8_t *dst, const uint8_t *src, uint32_t at, uint32_t n)
+{
+  uint32_t j, bytes = (n+7)/8, end = (at+n+7)/8;
+  uint8_t s = at & 7;
+  src += at/8;
+  end -= at/8;
+  if(s == 0)
+  {
+    memcpy(dst, src, bytes);
+    return;
+  }
+  for(j = 0; j < bytes; j++)
+  {
+    uint8_t next = j+1 < end ? src[j+1] : 0;
+    if(Msb)
+      dst[j] = src[j] << s | next >> (8-s);
+    else
+      dst[j] = src[j] >> s | next << (8-s);
+  }
+}
+
+void svfscan_bits_extract(uint8_t *dst, const uint8_t *src, uint32_t at, uint32_t n, uint8_t msb_first)
+{
+  if(msb_first)
+    bits_extract<1>(dst, src, at, n);
+  else
+    bits_extract<0>(dst, src, at, n);
+}
+
+template<uint8_t Msb>
+static uint32_t gather(struct S_jtaghw *hw, uint8_t *dst)
+{
+  uint32_t at = 0;
+  uint8_t v;
+  for(; hw != NULL; hw = hw->next)
+  {
+    if(hw->header_bits)
+    {
+      // header nibble moved to the first bits of a byte
+      v = Msb ? hw->header[0] << 4 : hw->header[0] >> 4;
+      bits_merge<Msb>(dst, at, &v, hw->header_bits);
+      at += hw->header_bits;
+    }
+    if(hw->data_bytes)
+    {
+      bits_merge<Msb>(dst, at, hw->data, 8 * hw->data_bytes);
+      at += 8 * hw->data_bytes;
+    }
+    if(hw->trailer_bits)
+    {
+      if(Msb)
+        v = hw->trailer[0] & (0xFF << (8 - hw->trailer_bits));
+      else
+        v = hw->trailer[0] & (0xFF >> (8 - hw->trailer_bits));
+      bits_merge<Msb>(dst, at, &v, hw->trailer_bits);
+      at += hw->trailer_bits;
+    }
+  }
+  return at;
+}
+
+uint32_t svfscan_gather(struct S_jtaghw *hw, uint8_t *dst, uint8_t msb_first)
+{
+  if(msb_first)
+    return gather<1>(hw, dst);
+  return gather<0>(hw, dst);
+}
+
+template<uint8_t Msb>
+static void scatter(struct S_jtaghw *hw, const uint8_t *src)
+{
+  uint32_t at = 0;
+  uint8_t v;
+  for(; hw != NULL; hw = hw->next)
+  {
+    if(hw->header_bits)
+    {
+      // first bits of a byte back to the header nibble
+      bits_extract<Msb>(&v, src, at, hw->header_bits);
+      hw->header[0] = Msb ? v >> 4 : v << 4;
+      at += hw->header_bits;
+    }
+    if(hw->data_bytes)
+    {
+      bits_extract<Msb>(hw->data, src, at, 8 * hw->data_bytes);
+      at += 8 * hw->data_bytes;
+    }
+    if(hw->trailer_bits)
+    {
+      bits_extract<Msb>(&v, src, at, hw->trailer_bits);
+      if(Msb)
+        hw->trailer[0] = v & (0xFF << (8 - hw->trailer_bits));
+      else
+        hw->trailer[0] = v & (0xFF >> (8 - hw->trailer_bits));
+      at += hw->trailer_bits;
+    }
+  }
+}
+
+void svfscan_scatter(struct S_jtaghw *hw, const uint8_t *src, uint8_t msb_first)
+{
+  if(msb_first)
+    scatter<1>(hw, src);
+  else
+    scatter<0>(hw, src);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// 32 bytes at a time, nibbles looked up with pshufb
+__attribute__((target("avx2")))
+static uint32_t reverse_avx2(uint8_t *buf, uint32_t bytes)
+{
+  const __m256i rev = _mm256_setr_epi8(0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF,
+    0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF);
+  const __m256i low = _mm256_set1_epi8(0x0F);
+  uint32_t j;
+  for(j = 0; j + 32 <= bytes; j += 32)
+  {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(buf + j));
+    __m256i lo = _mm256_shuffle_epi8(rev, _mm256_and_si256(x, low));
+    __m256i hi = _mm256_shuffle_epi8(rev, _mm256_and_si256(_mm256_srli_epi16(x, 4), low));
+    _mm256_storeu_si256((__m256i *)(buf + j), _mm256_or_si256(_mm256_slli_epi16(lo, 4), hi));
+  }
+  return j;
+}
+
+// 16 bytes at a time
+__attribute__((target("ssse3")))
+static uint32_t reverse_ssse3(uint8_t *buf, uint32_t bytes)
+{
+  const __m128i rev = _mm_setr_epi8(0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF);
+  const __m128i low = _mm_set1_epi8(0x0F);
+  uint32_t j;
+  for(j = 0; j + 16 <= bytes; j += 16)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i *)(buf + j));
+    __m128i lo = _mm_shuffle_epi8(rev, _mm_and_si128(x, low));
+    __m128i hi = _mm_shuffle_epi8(rev, _mm_and_si128(_mm_srli_epi16(x, 4), low));
+    _mm_storeu_si128((__m128i *)(buf + j), _mm_or_si128(_mm_slli_epi16(lo, 4), hi));
+  }
+  return j;
+}
+#endif
+
+void svfscan_reverse(uint8_t *buf, uint32_t bytes)
+{
+  uint32_t j = 0;
+  #if defined(__x86_64__) || defined(__i386__)
+  if(__builtin_cpu_supports("avx2"))
+    j = reverse_avx2(buf, bytes);
+  else if(__builtin_cpu_supports("ssse3"))
+    j = reverse_ssse3(buf, bytes);
+  #endif
+  for(; j < bytes; j++)
+    buf[j] = ReverseNibble[buf[j] >> 4] | ReverseNibble[buf[j] & 0xF] << 4;
+}
+
+// one piece of segment hw for a chunk: header if head,
+// data bytes [off, off+n), trailer if tail. done: piece
+// ends the segment
+static void chunk_piece(struct S_jtaghw *d, struct S_jtaghw *hw, uint8_t head, uint32_t off, uint32_t n,
+  uint8_t tail, uint8_t done)
+{
+  memset(d, 0, sizeof(struct S_jtaghw));
+  d->fill = hw->fill;
+  if(head)
+  {
+    d->header = hw->header;
+    d->header_bits = hw->header_bits;
+  }
+  if(n > 0)
+  {
+    d->data = hw->data + off;
+    d->data_bytes = n;
+  }
+  if(tail)
+  {
+    d->trailer = hw->trailer;
+    d->trailer_bits = hw->trailer_bits;
+  }
+  if(done && hw->next == NULL)
+  {
+    // last piece of the scan leaves Shift
+    d->tms_exit = hw->tms_exit;
+    d->tms_post = hw->tms_post;
+    d->tms_post_bits = hw->tms_post_bits;
+  }
+}
+
+int32_t svfscan_shift(struct S_svfscan_buf *c, struct S_jtaghw *tdi, struct S_jtaghw *tdo, uint32_t max_bytes)
+{
+  uint32_t segs, bytes = scan_bytes(tdi, &segs, 0);
+  if(max_bytes == 0 || bytes <= max_bytes)
+  {
+    jtag_tdi_tdo(tdi, tdo);
+    return 1;
+  }
+  // each chunk boundary splits at most one segment
+  uint32_t n = segs + bytes / max_bytes + 1;
+  if(svfscan_reserve(c, 0, 2*n) < 0)
+    return -1;
+  struct S_jtaghw *di = c->seg, *dd = c->seg + n; // next free tdi, tdo descriptor
+  struct S_jtaghw *first = di, *last = NULL; // chunk being built
+  uint32_t room = max_bytes;
+  int32_t chunks = 0;
+  for(; tdi != NULL; tdi = tdi->next, tdo = tdo->next)
+  {
+    uint8_t head = tdi->header_bits != 0, tail = tdi->trailer_bits != 0;
+    uint32_t off = 0;
+    while(head || off < tdi->data_bytes || tail)
+    {
+      if(room == 0)
+      {
+        // chunk full: shifted with TMS 0, scan goes on
+        last->next = NULL;
+        last[n].next = NULL;
+        jtag_tdi_tdo(first, first + n);
+        chunks++;
+        first = di;
+        last = NULL;
+        room = max_bytes;
+      }
+      uint8_t h = head;
+      room -= h;
+      uint32_t take = tdi->data_bytes - off < room ? tdi->data_bytes - off : room;
+      room -= take;
+      uint8_t t = tail && off + take == tdi->data_bytes && room > 0;
+      room -= t;
+      head = 0;
+      off += take;
+      tail -= t;
+      uint8_t done = off == tdi->data_bytes && !tail;
+      chunk_piece(di, tdi, h, off - take, take, t, done);
+      chunk_piece(dd, tdo, h, off - take, take, t, done);
+      if(last != NULL)
+      {
+        last->next = di;
+        last[n].next = dd;
+      }
+      last = di++;
+      dd++;
+    }
+  }
+  last->next = NULL;
+  last[n].next = NULL;
+  jtag_tdi_tdo(first, first + n);
+  return chunks + 1;
+}
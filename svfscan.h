@@ -0,0 +1,73 @@
+#ifndef SVFSCAN_H
+#define SVFSCAN_H
+
+#include <stdint.h>
+#include "jtaghw.h"
+
+/*
+memory behind S_jtaghw segment chains.
+
+fill pages: shared read-only 0x00 and 0xFF bytes, TDI of
+fill segments (padding) points here, any length of padding
+is shifted as bulk data without a buffer of its own.
+
+scan buffer: memory reused from scan to scan, either an
+owned copy of a TDI chain or the TDO capture of it,
+with the same segment layout.
+*/
+
+// bytes of each fill page, fill segments are at most this long
+#define SVFSCAN_FILL_BYTES 1024
+
+struct S_svfscan_buf
+{
+  uint8_t *buf; // bits of all segments
+  uint32_t allocated; // bytes allocated in buf
+  struct S_jtaghw *seg; // segment chain, points into buf
+  uint32_t seg_allocated; // descriptors allocated in seg
+  uint32_t grows; // reallocations of buf and seg
+};
+
+// fill page with pad byte value 0x00 or 0xFF
+uint8_t *svfscan_fill(uint8_t pad);
+// grow buffer and descriptor array
+// return value:
+// 0 - ok
+// -1 - memory allocation failed
+int8_t svfscan_reserve(struct S_svfscan_buf *b, uint32_t bytes, uint32_t segs);
+// owned copy of the tdi chain, fill segments stay shared.
+// NULL if memory allocation failed
+struct S_jtaghw *svfscan_copy(struct S_svfscan_buf *b, struct S_jtaghw *tdi);
+// chain with the layout of tdi for the TDO bits.
+// NULL if memory allocation failed
+struct S_jtaghw *svfscan_capture(struct S_svfscan_buf *b, struct S_jtaghw *tdi);
+void svfscan_free(struct S_svfscan_buf *b);
+
+// merge n packed bits from src to bit position at of dst.
+// dst bits from at on must be 0, src bits above n too.
+// msb_first: bit order of the bytes, as in S_svfparser
+void svfscan_bits_merge(uint8_t *dst, uint32_t at, const uint8_t *src, uint32_t n, uint8_t msb_first);
+// copy n packed bits from bit position at of src to dst
+// from bit 0. bits above n in the last dst byte are undefined
+void svfscan_bits_extract(uint8_t *dst, const uint8_t *src, uint32_t at, uint32_t n, uint8_t msb_first);
+// pack the bits of a segment chain in shift order to dst,
+// dst must be cleared. return value: number of bits
+uint32_t svfscan_gather(struct S_jtaghw *hw, uint8_t *dst, uint8_t msb_first);
+// unpack bits in shift order from src to the segments
+// of a chain, reverse of svfscan_gather()
+void svfscan_scatter(struct S_jtaghw *hw, const uint8_t *src, uint8_t msb_first);
+// bit-reverse each byte in place, converts between the orders
+void svfscan_reverse(uint8_t *buf, uint32_t bytes);
+
+// shift tdi, TDO to tdo (same layout), as chunks of at most
+// max_bytes bytes (header and trailer bits take a byte each),
+// one jtag_tdi_tdo() per chunk. all chunks but the last are
+// full and keep TMS 0, the last leaves Shift as tdi does.
+// chunk descriptors are taken from c->seg, bits stay in place.
+// max_bytes 0: whole scan in one transfer
+// return value:
+// >0 - number of chunks
+// -1 - memory allocation failed, nothing shifted
+int32_t svfscan_shift(struct S_svfscan_buf *c, struct S_jtaghw *tdi, struct S_jtaghw *tdo, uint32_t max_bytes);
+
+#endif
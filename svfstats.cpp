@@ -0,0 +1,49 @@
+#include "svfparser.h"
+#include "svfstats.h"
+
+void svfstats_get(struct S_svfparser *ctx, struct S_svfstats *stats)
+{
+  *stats = ctx->stats;
+  stats->reallocs += ctx->arena.heap_calls + ctx->capture.grows + ctx->chunks.grows + ctx->verify.grows;
+  if(ctx->verify.queue != NULL)
+    for(int i = 0; i < SVFVERIFY_BATCH; i++)
+      stats->reallocs += ctx->verify.queue[i].tdo.grows + ctx->verify.queue[i].expect.grows;
+  stats->field_peak = ctx->arena.chunks_high * SVF_CHUNK_BYTES;
+  stats->value_hits = ctx->cache.value_hits;
+  stats->value_misses = ctx->cache.value_misses;
+  stats->scan_hits = ctx->cache.scan_hits;
+  stats->scan_misses = ctx->cache.scan_misses;
+}
+
+void svfstats_json(struct S_svfparser *ctx, FILE *fp)
+{
+  struct S_svfstats st;
+  struct S_svflatency *l = &st.shift;
+  int j, n;
+  svfstats_get(ctx, &st);
+  fprintf(fp, "{\n  \"bytes\": %llu,\n  \"commands\": {", (unsigned long long)st.bytes);
+  for(j = 0; j < CMD_NUM; j++)
+    fprintf(fp, "%s\"%s\": %u", j ? ", " : "", Svf_command_name[j], st.commands[j]);
+  fprintf(fp, "},\n  \"sdr\": {\"scans\": %u, \"bits\": %llu},\n  \"sir\": {\"scans\": %u, \"bits\": %llu},\n",
+    st.scans[0], (unsigned long long)st.scan_bits[0], st.scans[1], (unsigned long long)st.scan_bits[1]);
+  fprintf(fp, "  \"reallocs\": %u,\n  \"field_peak_bytes\": %u,\n", st.reallocs, st.field_peak);
+  fprintf(fp, "  \"cache\": {\"value_hits\": %u, \"value_misses\": %u, \"scan_hits\": %u, \"scan_misses\": %u},\n",
+    st.value_hits, st.value_misses, st.scan_hits, st.scan_misses);
+  fprintf(fp, "  \"parse_ns\": %llu,\n  \"shift_ns\": %llu,\n",
+    (unsigned long long)st.parse_ns, (unsigned long long)l->ns);
+  // histogram up to the last bucket in use, limits in us
+  for(n = SVFSTATS_BUCKETS; n > 0 && l->hist[n-1] == 0; n--);
+  fprintf(fp, "  \"shift_latency\": {\"scans\": %u, \"max_ns\": %llu, \"below_us\": [",
+    l->count, (unsigned long long)l->max_ns);
+  for(j = 0; j < n; j++)
+  {
+    if(j == SVFSTATS_BUCKETS-1)
+      fprintf(fp, "%snull", j ? ", " : ""); // no upper limit
+    else
+      fprintf(fp, "%s%llu", j ? ", " : "", 1ull << j);
+  }
+  fprintf(fp, "], \"count\": [");
+  for(j = 0; j < n; j++)
+    fprintf(fp, "%s%u", j ? ", " : "", l->hist[j]);
+  fprintf(fp, "]}\n}\n");
+}
@@ -0,0 +1,58 @@
+#ifndef SVFSTATS_H
+#define SVFSTATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+always-on counters of the parser, cheap enough for
+production: a few adds per command, two clock reads
+per packet and per shifted scan, no output until asked.
+
+counters live in S_svfparser.stats (svfparser.h),
+svfstats_get() adds the totals kept by the arena, the
+caches and the scan buffers, svfstats_json() writes
+them all.
+*/
+
+// latency histogram: bucket 0 counts scans under 1 us,
+// bucket j from 2^(j-1) up to 2^j us, the last one the rest
+#define SVFSTATS_BUCKETS 24
+
+// time of each jtag_tdi_tdo() shift of a scan
+struct S_svflatency
+{
+  uint32_t count; // scans shifted
+  uint64_t ns; // total time
+  uint64_t max_ns; // slowest scan
+  uint32_t hist[SVFSTATS_BUCKETS];
+};
+
+static inline uint64_t svfstats_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline void svfstats_latency(struct S_svflatency *l, uint64_t ns)
+{
+  uint64_t us = ns / 1000;
+  uint32_t j = us == 0 ? 0 : 64 - __builtin_clzll(us);
+  l->count++;
+  l->ns += ns;
+  if(ns > l->max_ns)
+    l->max_ns = ns;
+  l->hist[j < SVFSTATS_BUCKETS ? j : SVFSTATS_BUCKETS-1]++;
+}
+
+struct S_svfparser;
+struct S_svfstats;
+
+// copy of ctx->stats with the totals of its buffers added
+void svfstats_get(struct S_svfparser *ctx, struct S_svfstats *stats);
+// all counters as one JSON object
+void svfstats_json(struct S_svfparser *ctx, FILE *fp);
+
+#endif
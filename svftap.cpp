@@ -0,0 +1,159 @@
+#include <string.h>
+#include "svfparser.h" // enum libxsvf_tap_state
+#include "svftap.h"
+
+// TAP states without INIT, indexed from LIBXSVF_TAP_RESET
+#define TAP_STATES (LIBXSVF_TAP_NUM - LIBXSVF_TAP_RESET)
+#define TAP(s) ((s) - LIBXSVF_TAP_RESET)
+
+// next state for TMS=0 and TMS=1 (IEEE 1149.1 figure 6-1)
+constexpr uint8_t Tap_next[LIBXSVF_TAP_NUM][2] =
+{
+  [LIBXSVF_TAP_INIT]      = { LIBXSVF_TAP_INIT,      LIBXSVF_TAP_INIT },
+  [LIBXSVF_TAP_RESET]     = { LIBXSVF_TAP_IDLE,      LIBXSVF_TAP_RESET },
+  [LIBXSVF_TAP_IDLE]      = { LIBXSVF_TAP_IDLE,      LIBXSVF_TAP_DRSELECT },
+  [LIBXSVF_TAP_DRSELECT]  = { LIBXSVF_TAP_DRCAPTURE, LIBXSVF_TAP_IRSELECT },
+  [LIBXSVF_TAP_DRCAPTURE] = { LIBXSVF_TAP_DRSHIFT,   LIBXSVF_TAP_DREXIT1 },
+  [LIBXSVF_TAP_DRSHIFT]   = { LIBXSVF_TAP_DRSHIFT,   LIBXSVF_TAP_DREXIT1 },
+  [LIBXSVF_TAP_DREXIT1]   = { LIBXSVF_TAP_DRPAUSE,   LIBXSVF_TAP_DRUPDATE },
+  [LIBXSVF_TAP_DRPAUSE]   = { LIBXSVF_TAP_DRPAUSE,   LIBXSVF_TAP_DREXIT2 },
+  [LIBXSVF_TAP_DREXIT2]   = { LIBXSVF_TAP_DRSHIFT,   LIBXSVF_TAP_DRUPDATE },
+  [LIBXSVF_TAP_DRUPDATE]  = { LIBXSVF_TAP_IDLE,      LIBXSVF_TAP_DRSELECT },
+  [LIBXSVF_TAP_IRSELECT]  = { LIBXSVF_TAP_IRCAPTURE, LIBXSVF_TAP_RESET },
+  [LIBXSVF_TAP_IRCAPTURE] = { LIBXSVF_TAP_IRSHIFT,   LIBXSVF_TAP_IREXIT1 },
+  [LIBXSVF_TAP_IRSHIFT]   = { LIBXSVF_TAP_IRSHIFT,   LIBXSVF_TAP_IREXIT1 },
+  [LIBXSVF_TAP_IREXIT1]   = { LIBXSVF_TAP_IRPAUSE,   LIBXSVF_TAP_IRUPDATE },
+  [LIBXSVF_TAP_IRPAUSE]   = { LIBXSVF_TAP_IRPAUSE,   LIBXSVF_TAP_IREXIT2 },
+  [LIBXSVF_TAP_IREXIT2]   = { LIBXSVF_TAP_IRSHIFT,   LIBXSVF_TAP_IRUPDATE },
+  [LIBXSVF_TAP_IRUPDATE]  = { LIBXSVF_TAP_IDLE,      LIBXSVF_TAP_DRSELECT },
+};
+
+// shortest TMS sequence, first bit in bit 0
+struct S_tms_path
+{
+  uint8_t tms;
+  uint8_t bits;
+};
+
+struct S_tms_table
+{
+  struct S_tms_path path[TAP_STATES][TAP_STATES];
+  uint8_t longest;
+};
+
+// breadth-first search from every state. Exit2 -> Shift
+// (resume a paused shift) is never taken: each SVF scan
+// starts with Capture, from Pause through Update
+constexpr struct S_tms_table tms_table()
+{
+  struct S_tms_table t = {};
+  for(int from = 0; from < TAP_STATES; from++)
+  {
+    uint8_t seen[TAP_STATES] = {}, queue[TAP_STATES] = {};
+    int head = 0, tail = 0;
+    seen[from] = 1;
+    queue[tail++] = from;
+    while(head < tail)
+    {
+      int s = queue[head++];
+      for(int tms = 0; tms < 2; tms++)
+      {
+        int n = TAP(Tap_next[s + LIBXSVF_TAP_RESET][tms]);
+        if(tms == 0 && (s == TAP(LIBXSVF_TAP_DREXIT2) || s == TAP(LIBXSVF_TAP_IREXIT2)))
+          continue;
+        if(seen[n])
+          continue;
+        seen[n] = 1;
+        queue[tail++] = n;
+        t.path[from][n].tms = t.path[from][s].tms | tms << t.path[from][s].bits;
+        t.path[from][n].bits = t.path[from][s].bits + 1;
+        if(t.path[from][n].bits > t.longest)
+          t.longest = t.path[from][n].bits;
+      }
+    }
+  }
+  return t;
+}
+
+constexpr struct S_tms_table Tms_table = tms_table();
+static_assert(Tms_table.longest <= 8, "TMS path does not fit in a byte");
+
+// append bits of tms, first bit in bit 0
+static void tms_append(struct S_svftap *tap, uint8_t tms, uint8_t bits)
+{
+  for(; bits > 0; bits--, tms >>= 1)
+  {
+    if(tap->tms_bits == SVFTAP_BURST_BITS)
+      svftap_flush(tap);
+    uint8_t mask = 1 << (tap->tms_bits & 7);
+    if(tms & 1)
+      tap->tms[tap->tms_bits / 8] |= mask;
+    else
+      tap->tms[tap->tms_bits / 8] &= ~mask;
+    tap->tms_bits++;
+  }
+}
+
+void svftap_init(struct S_svftap *tap, void (*burst)(void *user, uint8_t *tms, uint32_t bits), void *user)
+{
+  memset(tap, 0, sizeof(struct S_svftap));
+  tap->state = LIBXSVF_TAP_INIT;
+  tap->burst = burst;
+  tap->user = user;
+}
+
+void svftap_goto(struct S_svftap *tap, uint8_t state)
+{
+  if(state == LIBXSVF_TAP_INIT || state >= LIBXSVF_TAP_NUM)
+    return;
+  if(tap->state == LIBXSVF_TAP_INIT)
+  {
+    // 5 times TMS=1 reaches Test-Logic-Reset from anywhere
+    tms_append(tap, 0x1F, 5);
+    tap->state = LIBXSVF_TAP_RESET;
+  }
+  const struct S_tms_path *p = &Tms_table.path[TAP(tap->state)][TAP(state)];
+  tms_append(tap, p->tms, p->bits);
+  tap->state = state;
+}
+
+int8_t svftap_exit(struct S_svftap *tap, uint8_t state, uint8_t *tms)
+{
+  if(tap->state != LIBXSVF_TAP_DRSHIFT && tap->state != LIBXSVF_TAP_IRSHIFT)
+    return -1;
+  if(state == LIBXSVF_TAP_INIT || state >= LIBXSVF_TAP_NUM)
+    state = Tap_next[tap->state][1];
+  const struct S_tms_path *p = &Tms_table.path[TAP(Tap_next[tap->state][1])][TAP(state)];
+  *tms = p->tms;
+  tap->state = state;
+  return p->bits;
+}
+
+void svftap_path(struct S_svftap *tap, uint8_t *path, uint8_t n)
+{
+  for(uint8_t i = 0; i < n; i++)
+    svftap_goto(tap, path[i]);
+}
+
+uint8_t svftap_next(uint8_t state, uint8_t tms)
+{
+  if(state >= LIBXSVF_TAP_NUM)
+    return LIBXSVF_TAP_INIT;
+  return Tap_next[state][tms & 1];
+}
+
+uint8_t svftap_tms(uint8_t from, uint8_t to, uint8_t *tms)
+{
+  const struct S_tms_path *p = &Tms_table.path[TAP(from)][TAP(to)];
+  *tms = p->tms;
+  return p->bits;
+}
+
+void svftap_flush(struct S_svftap *tap)
+{
+  if(tap->tms_bits == 0)
+    return;
+  if(tap->burst)
+    tap->burst(tap->user, tap->tms, tap->tms_bits);
+  tap->tms_bits = 0;
+}
@@ -0,0 +1,59 @@
+#ifndef SVFTAP_H
+#define SVFTAP_H
+
+#include <stdint.h>
+
+/*
+TAP state machine engine.
+
+tracks the current TAP state (enum libxsvf_tap_state) and
+turns state changes into TMS bits, using a compile-time
+table of the shortest TMS path between any two of the
+16 TAP states.
+
+moves are not clocked immediately: TMS bits collect in
+a burst and consecutive moves (end state of a scan, STATE,
+RUNTEST, the way to the next Shift state) are handed
+to the backend together. the burst is flushed before
+each scan, when it is full and by svftap_flush().
+
+TMS bits are packed in clocking order:
+first bit is bit 0 of byte 0.
+*/
+
+// TMS bits buffered in one burst
+#define SVFTAP_BURST_BYTES 32
+#define SVFTAP_BURST_BITS (8*SVFTAP_BURST_BYTES)
+
+struct S_svftap
+{
+  uint8_t state; // current TAP state, LIBXSVF_TAP_INIT if unknown
+  uint8_t tms[SVFTAP_BURST_BYTES]; // packed TMS bits not yet clocked
+  uint32_t tms_bits; // number of bits in tms[]
+  // receiver of TMS bursts, called with user
+  void (*burst)(void *user, uint8_t *tms, uint32_t bits);
+  void *user;
+};
+
+// start in unknown state, bursts go to burst(user, ...)
+void svftap_init(struct S_svftap *tap, void (*burst)(void *user, uint8_t *tms, uint32_t bits), void *user);
+// move to state along the shortest path,
+// from unknown state through Test-Logic-Reset
+void svftap_goto(struct S_svftap *tap, uint8_t state);
+// walk STATE path, states in walking order
+void svftap_path(struct S_svftap *tap, uint8_t *path, uint8_t n);
+// scan in Shift state ends: its last bit moves to Exit1,
+// TMS bits from Exit1 to state are stored to *tms.
+// return value:
+// >= 0 - number of bits in *tms
+// -1 - not in a Shift state, nothing done
+int8_t svftap_exit(struct S_svftap *tap, uint8_t state, uint8_t *tms);
+// hand buffered TMS bits to the backend
+void svftap_flush(struct S_svftap *tap);
+// state after one TCK with tms, for backends following the TAP
+uint8_t svftap_next(uint8_t state, uint8_t tms);
+// shortest TMS path between two known states to *tms,
+// first bit in bit 0. return value: number of bits
+uint8_t svftap_tms(uint8_t from, uint8_t to, uint8_t *tms);
+
+#endif
@@ -0,0 +1,21 @@
+#include <stdio.h>
+#include <string.h>
+#include "svftrace.h"
+
+int8_t svftrace_write(struct S_svftrace *t, const char *filename)
+{
+  struct S_svftrace_header h;
+  FILE *fp = fopen(filename, "wb");
+  if(fp == NULL)
+    return -1;
+  memcpy(h.magic, SVFTRACE_MAGIC, sizeof(h.magic));
+  h.version = SVFTRACE_VERSION;
+  h.event_bytes = sizeof(struct S_svftrace_event);
+  h.events = SVFTRACE_EVENTS;
+  h.head = t->head;
+  uint8_t ok = fwrite(&h, sizeof(h), 1, fp) == 1
+    && fwrite(t->ring, sizeof(t->ring), 1, fp) == 1;
+  if(fclose(fp) != 0)
+    ok = 0;
+  return ok ? 0 : -1;
+}
@@ -0,0 +1,94 @@
+#ifndef SVFTRACE_H
+#define SVFTRACE_H
+
+#include <stdint.h>
+
+/*
+binary trace of the parser: fixed-size ring of event
+records, written without formatting, so it can stay
+enabled in production. the ring keeps the last
+SVFTRACE_EVENTS events, svftrace_write() dumps it
+(e.g. when a board fails) and the svftracedec tool
+prints the dump offline.
+
+dump file: S_svftrace_header, then the ring as it is
+in memory, host byte order. slot of event n is
+n % SVFTRACE_EVENTS, head is the number of events
+ever put, empty slots have id TR_NONE.
+*/
+
+// build with SVF_TRACE=0 to compile tracing out
+#ifndef SVF_TRACE
+#define SVF_TRACE 1
+#endif
+
+// events kept, must be power of 2
+#ifndef SVFTRACE_EVENTS
+#define SVFTRACE_EVENTS 256
+#endif
+
+#define SVFTRACE_MAGIC "SVFT"
+#define SVFTRACE_VERSION 1
+
+// event ids, arguments in the order small, a, b
+enum svftrace_event
+{
+  TR_NONE = 0, // empty slot
+  TR_PACKET, // final, stream index, length
+  TR_PACKET_END, // command state (-1 incomplete), line count
+  TR_COMMAND, // CMD_ token found, line
+  TR_COMPLETE, // CMD_ token, line of the ;
+  TR_LENGTH, // -, bit length of a bit sequence command
+  TR_FIELD, // BSF_ field name
+  TR_OPEN, // BSF_ field, digits expected
+  TR_CLOSE, // BSF_ field, leading digits not given
+  TR_OVERRUN, // BSF_ field, digit index, hex digits skipped
+  TR_STATE, // TAP state of STATE, ENDxR or RUNTEST, 1: not allowed there
+  TR_RUNTEST, // run state, clocks, min time in us
+  TR_SPLIT, // BSF_ field, digits given, pad bits
+  TR_CACHED, // BSF_ field
+  TR_SCAN, // 1: SIR 0: SDR, bits with header and trailer, end state
+  TR_ALLOC, // -, bytes: memory allocation failed
+  TR_NUM
+};
+
+struct S_svftrace_event
+{
+  uint16_t id; // enum svftrace_event
+  uint16_t small; // small argument: token, field, state
+  uint32_t command; // SVF command index, from 1
+  uint32_t a, b;
+};
+
+struct S_svftrace_header
+{
+  char magic[4]; // SVFTRACE_MAGIC
+  uint16_t version; // SVFTRACE_VERSION
+  uint16_t event_bytes; // sizeof(struct S_svftrace_event)
+  uint32_t events; // ring slots, SVFTRACE_EVENTS of the writer
+  uint32_t head; // events put
+};
+
+struct S_svftrace
+{
+  uint32_t head; // events put, next slot is head % SVFTRACE_EVENTS
+  struct S_svftrace_event ring[SVFTRACE_EVENTS];
+};
+
+static inline void svftrace_put(struct S_svftrace *t, uint16_t id, uint32_t command, uint16_t small, uint32_t a, uint32_t b)
+{
+  struct S_svftrace_event *e = &t->ring[t->head++ & (SVFTRACE_EVENTS-1)];
+  e->id = id;
+  e->small = small;
+  e->command = command;
+  e->a = a;
+  e->b = b;
+}
+
+// dump the ring to a file
+// return value:
+// 0 - ok
+// -1 - file can't be written
+int8_t svftrace_write(struct S_svftrace *t, const char *filename);
+
+#endif
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "svfparser.h" // CMD_, BSF_ and TAP state names
+#include "svftrace.h"
+
+// offline decoder of svftrace dumps: prints the events
+// of the ring oldest first, one per line
+
+// name from a table, "?" if out of range
+static const char *name(const char *const *table, uint32_t n, uint32_t j)
+{
+  return j < n && table[j] != NULL ? table[j] : "?";
+}
+
+#define COMMAND(j) name(Svf_command_name, CMD_NUM, j)
+#define FIELD(j) name(Svf_field_name, BSF_NUM, j)
+#define STATE(j) name(Svf_tap_state_name, LIBXSVF_TAP_NUM, j)
+
+static void print_event(uint32_t n, struct S_svftrace_event *e)
+{
+  printf("%8u cmd %6u  ", n, e->command);
+  switch(e->id)
+  {
+    case TR_PACKET:
+      printf("packet at %u, %u bytes%s\n", e->a, e->b, e->small ? ", final" : "");
+      break;
+    case TR_PACKET_END:
+      printf("packet end, line %u, command %s\n", e->a,
+        (int16_t)e->small < 0 ? "incomplete" : e->small ? "complete" : "in progress");
+      break;
+    case TR_COMMAND:
+      printf("%s found, line %u\n", COMMAND(e->small), e->a);
+      break;
+    case TR_COMPLETE:
+      printf("%s complete, line %u\n", COMMAND(e->small), e->a);
+      break;
+    case TR_LENGTH:
+      printf("length %u\n", e->a);
+      break;
+    case TR_FIELD:
+      printf("field %s\n", FIELD(e->small));
+      break;
+    case TR_OPEN:
+      printf("%s open, %u digits\n", FIELD(e->small), e->a);
+      break;
+    case TR_CLOSE:
+      printf("%s close, %u leading digits not given\n", FIELD(e->small), e->a);
+      break;
+    case TR_OVERRUN:
+      printf("%s OVERRUN at digit %d, %u digits skipped\n", FIELD(e->small), (int32_t)e->a, e->b);
+      break;
+    case TR_STATE:
+      printf("state %s%s\n", STATE(e->small), e->a ? ", not allowed" : "");
+      break;
+    case TR_RUNTEST:
+      printf("run %u TCK in %s, min %u us\n", e->a, STATE(e->small), e->b);
+      break;
+    case TR_SPLIT:
+      printf("%s split, %d digits, %u pad bits\n", FIELD(e->small), (int32_t)e->a, e->b);
+      break;
+    case TR_CACHED:
+      printf("%s cached\n", FIELD(e->small));
+      break;
+    case TR_SCAN:
+      printf("%s %u bits, end %s\n", e->small ? "SIR" : "SDR", e->a, STATE(e->b));
+      break;
+    case TR_ALLOC:
+      printf("memory allocation of %u bytes failed\n", e->a);
+      break;
+    default:
+      printf("event %u: %u %u %u\n", e->id, e->small, e->a, e->b);
+      break;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  struct S_svftrace_header h;
+  if(argc < 2)
+  {
+    printf("usage: %s svftrace.bin\n", argv[0]);
+    return 1;
+  }
+  FILE *fp = fopen(argv[1], "rb");
+  if(fp == NULL)
+  {
+    printf("can't open %s\n", argv[1]);
+    return 1;
+  }
+  if(fread(&h, sizeof(h), 1, fp) != 1 || memcmp(h.magic, SVFTRACE_MAGIC, sizeof(h.magic)) != 0
+  || h.version != SVFTRACE_VERSION || h.event_bytes != sizeof(struct S_svftrace_event)
+  || h.events == 0 || (h.events & (h.events-1)) != 0)
+  {
+    printf("%s is not a trace of this version\n", argv[1]);
+    fclose(fp);
+    return 1;
+  }
+  // ring size is the writer's, may differ from ours
+  struct S_svftrace_event *ring = (struct S_svftrace_event *)calloc(h.events, sizeof(struct S_svftrace_event));
+  size_t got = fread(ring, sizeof(struct S_svftrace_event), h.events, fp);
+  fclose(fp);
+  if(got != h.events)
+  {
+    printf("%s is truncated\n", argv[1]);
+    free(ring);
+    return 1;
+  }
+  uint32_t first = h.head > h.events ? h.head - h.events : 0;
+  printf("%u events, last %u kept\n", h.head, h.head - first);
+  for(uint32_t n = first; n != h.head; n++)
+  {
+    struct S_svftrace_event *e = &ring[n & (h.events-1)];
+    if(e->id != TR_NONE)
+      print_event(n, e);
+  }
+  free(ring);
+  return 0;
+}
@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "svfparser.h"
+#include "svfscan.h"
+#include "svfverify.h"
+
+#ifndef DBG_PRINT
+#define DBG_PRINT 1
+#endif
+#if DBG_PRINT
+#define PRINTF(f_, ...) printf((f_), ##__VA_ARGS__)
+#else
+#define PRINTF(f_, ...)
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// first bit in shift order of a nonzero word loaded
+// from memory in little endian byte order
+template<uint8_t Msb>
+static inline uint32_t first_bit(uint64_t d)
+{
+  uint32_t byte = __builtin_ctzll(d) / 8;
+  uint8_t b = d >> (8 * byte);
+  if(Msb)
+    return 8 * byte + __builtin_clz(b) - 24;
+  return 8 * byte + __builtin_ctz(b);
+}
+
+template<uint8_t Msb>
+static int64_t verify_bits(const uint8_t *tdo, const uint8_t *expected, const uint8_t *mask, uint32_t n)
+{
+  uint32_t j = 0, bytes = n/8;
+  uint64_t t, e, m, d;
+  #if defined(__SSE2__)
+  // skip matching blocks of 16 bytes
+  const __m128i zero = _mm_setzero_si128();
+  for(; j + 16 <= bytes; j += 16)
+  {
+    __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(tdo + j)),
+      _mm_loadu_si128((const __m128i *)(expected + j)));
+    x = _mm_and_si128(x, _mm_loadu_si128((const __m128i *)(mask + j)));
+    if(_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero)) != 0xFFFF)
+      break;
+  }
+  #endif
+  for(; j + 8 <= bytes; j += 8)
+  {
+    memcpy(&t, tdo + j, 8);
+    memcpy(&e, expected + j, 8);
+    memcpy(&m, mask + j, 8);
+    d = (t ^ e) & m;
+    if(d != 0)
+      return 8 * (int64_t)j + first_bit<Msb>(d);
+  }
+  // remaining bytes, last one only up to n bits
+  for(; j < (n+7)/8; j++)
+  {
+    d = (tdo[j] ^ expected[j]) & mask[j];
+    if(j == bytes)
+    {
+      if(Msb)
+        d &= 0xFF << (8 - (n & 7));
+      else
+        d &= 0xFF >> (8 - (n & 7));
+    }
+    if(d != 0)
+      return 8 * (int64_t)j + first_bit<Msb>(d);
+  }
+  return -1;
+}
+
+int64_t svfverify_bits(const uint8_t *tdo, const uint8_t *expected, const uint8_t *mask, uint32_t n, uint8_t msb_first)
+{
+  if(msb_first)
+    return verify_bits<1>(tdo, expected, mask, n);
+  return verify_bits<0>(tdo, expected, mask, n);
+}
+
+int64_t svfverify_scan(struct S_svfverify *v, struct S_jtaghw *tdo, struct S_svfcheck *check)
+{
+  uint32_t bits = 0;
+  int64_t bit = 0; // chain of other length fails at bit 0
+  for(struct S_jtaghw *hw = tdo; hw != NULL; hw = hw->next)
+    bits += hw->header_bits + 8 * hw->data_bytes + hw->trailer_bits;
+  if(bits == check->length)
+  {
+    uint32_t bytes = (bits+7)/8;
+    if(bytes > v->allocated)
+    {
+      uint8_t *buf = (uint8_t *)realloc(v->buf, bytes);
+      if(buf == NULL)
+      {
+        PRINTF("Memory Allocation Failed\n");
+        return -2;
+      }
+      v->buf = buf;
+      v->allocated = bytes;
+      v->grows++;
+    }
+    memset(v->buf, 0, bytes);
+    svfscan_gather(tdo, v->buf, v->msb_first);
+    bit = svfverify_bits(v->buf, check->tdo, check->mask, bits, v->msb_first);
+  }
+  v->scans++;
+  if(bit < 0)
+    return -1;
+  v->failures++;
+  if(v->first_scan == 0)
+  {
+    v->first_scan = check->scan;
+    v->first_command = check->command;
+    v->first_line = check->line;
+    v->first_bit = bit;
+  }
+  PRINTF("TDO mismatch scan %u command %u line %u bit %u\n", check->scan, check->command, check->line, (uint32_t)bit);
+  return bit;
+}
+
+struct S_jtaghw *svfverify_defer(struct S_svfverify *v, struct S_jtaghw *tdi, struct S_svfcheck *check)
+{
+  if(v->queue == NULL)
+  {
+    v->queue = (struct S_svfverify_entry *)calloc(SVFVERIFY_BATCH, sizeof(struct S_svfverify_entry));
+    if(v->queue == NULL)
+      return NULL;
+  }
+  if(v->pending == SVFVERIFY_BATCH)
+    svfverify_run(v);
+  struct S_svfverify_entry *e = &v->queue[v->pending];
+  // expected bits of the command are reused by the next one
+  uint32_t bytes = (check->length+7)/8;
+  if(svfscan_reserve(&e->expect, 2*bytes, 0) < 0)
+    return NULL;
+  e->chain = svfscan_capture(&e->tdo, tdi);
+  if(e->chain == NULL)
+    return NULL;
+  memcpy(e->expect.buf, check->tdo, bytes);
+  memcpy(e->expect.buf + bytes, check->mask, bytes);
+  e->check = *check;
+  e->check.tdo = e->expect.buf;
+  e->check.mask = e->expect.buf + bytes;
+  v->pending++;
+  return e->chain;
+}
+
+uint32_t svfverify_run(struct S_svfverify *v)
+{
+  uint32_t failures = v->failures;
+  if(v->pending == 0)
+    return 0;
+  jtag_flush(); // TDO of all queued scans is in place
+  for(uint32_t i = 0; i < v->pending; i++)
+    svfverify_scan(v, v->queue[i].chain, &v->queue[i].check);
+  v->pending = 0;
+  return v->failures - failures;
+}
+
+void svfverify_free(struct S_svfverify *v)
+{
+  free(v->buf);
+  v->buf = NULL;
+  v->allocated = 0;
+  if(v->queue != NULL)
+  {
+    for(int i = 0; i < SVFVERIFY_BATCH; i++)
+    {
+      svfscan_free(&v->queue[i].tdo);
+      svfscan_free(&v->queue[i].expect);
+    }
+    free(v->queue);
+    v->queue = NULL;
+  }
+  v->pending = 0;
+}
@@ -0,0 +1,88 @@
+#ifndef SVFVERIFY_H
+#define SVFVERIFY_H
+
+#include <stdint.h>
+#include "jtaghw.h"
+#include "svfscan.h"
+
+/*
+TDO verification: captured TDO is gathered from its segment
+chain into packed bits and compared with the expected TDO
+as (captured XOR expected) AND mask, 16 bytes at a time
+with SSE2, 64-bit words otherwise. the first mismatching bit
+is found inside the first differing word.
+
+all bit sequences are packed in shift order, like the sink
+gets them: first bit is bit 0 of byte 0 (bit 7 when
+msb_first).
+
+deferred mode: a check does not wait for the TDO of its
+scan. captured and expected bits are queued in buffers of
+their own while scans keep flowing, the queue is checked
+in one batch after jtag_flush() when SVFVERIFY_BATCH scans
+are pending and at the end of the stream.
+*/
+
+// scans queued in deferred mode
+#define SVFVERIFY_BATCH 32
+
+// expected TDO of one scan
+struct S_svfcheck
+{
+  uint32_t scan; // scan number, from 1
+  uint32_t command; // SVF command index, from 1
+  uint32_t line; // SVF line of the command
+  uint32_t length; // bits
+  uint8_t *tdo; // expected TDO
+  uint8_t *mask; // 1: bit is compared
+};
+
+// deferred check: owned copies, alive until checked
+struct S_svfverify_entry
+{
+  struct S_svfscan_buf tdo; // captured TDO, written by the backend
+  struct S_jtaghw *chain; // tdo segment chain in tdo
+  struct S_svfscan_buf expect; // expected TDO and MASK
+  struct S_svfcheck check; // points into expect
+};
+
+// results of all checks
+struct S_svfverify
+{
+  uint8_t msb_first; // bit order of all bit sequences, set by the owner
+  uint8_t off; // not 0: backend has no real TDO, nothing is checked, set by the owner
+  uint32_t scans; // scans checked
+  uint32_t failures; // scans not matching
+  uint32_t first_scan; // scan number of the first failure, 0 if none
+  uint32_t first_command; // SVF command index of the first failure
+  uint32_t first_line; // SVF line of the first failure
+  uint32_t first_bit; // first mismatching bit of that scan, in shift order
+  uint8_t *buf; // gathered TDO
+  uint32_t allocated;
+  uint32_t grows; // reallocations of buf
+  uint8_t deferred; // not 0: checks are queued and run in batches
+  uint32_t pending; // entries queued
+  struct S_svfverify_entry *queue; // SVFVERIFY_BATCH entries, NULL until first used
+};
+
+// first bit where (tdo XOR expected) AND mask is 1
+// return value:
+// >= 0 - bit index in shift order
+// -1 - n bits match
+int64_t svfverify_bits(const uint8_t *tdo, const uint8_t *expected, const uint8_t *mask, uint32_t n, uint8_t msb_first);
+// compare captured tdo chain against check, mismatch is printed
+// return value:
+// >= 0 - bit index of the first mismatch, recorded in v
+// -1 - match
+// -2 - memory allocation failed
+int64_t svfverify_scan(struct S_svfverify *v, struct S_jtaghw *tdo, struct S_svfcheck *check);
+// queue check of the scan tdi, a full queue is checked first.
+// returns tdo chain for the backend to capture the scan,
+// NULL if memory allocation failed
+struct S_jtaghw *svfverify_defer(struct S_svfverify *v, struct S_jtaghw *tdi, struct S_svfcheck *check);
+// jtag_flush() and check all queued scans in queue order
+// return value: number of failed scans
+uint32_t svfverify_run(struct S_svfverify *v);
+void svfverify_free(struct S_svfverify *v);
+
+#endif